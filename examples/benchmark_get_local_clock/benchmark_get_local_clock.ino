@@ -0,0 +1,65 @@
+/*
+  precise_sntp example
+
+  This example measures how long a call of get_local_clock(), get_epoch(),
+  tget_epoch() and dget_epoch() takes and prints the result in
+  microseconds and cpu cycles per call to serial.
+  No network is needed, the local clock is not set.
+
+  Author: Daniel Mohr
+  Date: 2026-10-17
+*/
+
+#include <EthernetUdp.h>
+
+#include <precise_sntp.h>
+
+#define SERIAL_BAUD_RATE 115200
+#define SERIAL_TIMEOUT 1000
+#define N_CALLS 10000
+
+EthernetUDP udp;
+
+precise_sntp sntp(udp);
+
+volatile uint32_t sink;
+
+void print_result(const char *name, unsigned long duration) {
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print(((float) duration) / N_CALLS, 3);
+  Serial.print(" us/call, ");
+  Serial.print(((float) duration) / N_CALLS * (F_CPU / 1000000UL), 1);
+  Serial.println(" cycles/call");
+}
+
+void setup() {
+  Serial.begin(SERIAL_BAUD_RATE);
+  Serial.setTimeout(SERIAL_TIMEOUT);
+  while (!Serial);
+  Serial.println("-- start --");
+}
+
+void loop() {
+  unsigned long start = micros();
+  for (uint16_t i = 0; i < N_CALLS; i++) {
+    sink = sntp.get_local_clock().fraction;
+  }
+  print_result("get_local_clock", micros() - start);
+  start = micros();
+  for (uint16_t i = 0; i < N_CALLS; i++) {
+    sink = sntp.get_epoch();
+  }
+  print_result("get_epoch", micros() - start);
+  start = micros();
+  for (uint16_t i = 0; i < N_CALLS; i++) {
+    sink = sntp.tget_epoch().fraction;
+  }
+  print_result("tget_epoch", micros() - start);
+  start = micros();
+  for (uint16_t i = 0; i < N_CALLS; i++) {
+    sink = (uint32_t) sntp.dget_epoch();
+  }
+  print_result("dget_epoch", micros() - start);
+  delay(10000);
+}
@@ -0,0 +1,67 @@
+/*
+  precise_sntp example
+
+  This example gets the time without blocking the loop and print the to
+  serial. The loop keeps running while waiting for the answer of the server,
+  so other work (e. g. sampling sensors) is not delayed. The initial
+  synchronization is done by an asynchronous iburst.
+
+  Author: Daniel Mohr
+  Date: 2026-10-17
+*/
+
+#include <Ethernet.h>
+#include <EthernetUdp.h>
+
+#include <precise_sntp.h>
+
+#define SERIAL_BAUD_RATE 115200
+#define SERIAL_TIMEOUT 1000
+uint8_t mac[] = {0x02, 0x74, 0x72, 0x69, 0x67, 0x00};
+
+EthernetUDP udp;
+
+precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+
+unsigned long last_print = 0;
+
+void poll_finished(uint8_t result) {
+  Serial.print("poll finished with error code ");
+  Serial.println(result);
+}
+
+void setup() {
+  Serial.begin(SERIAL_BAUD_RATE);
+  Serial.setTimeout(SERIAL_TIMEOUT);
+  while (!Serial);
+  Serial.println("-- start --");
+  Ethernet.init(5);
+  if (Ethernet.begin(mac) == 0) {
+    Serial.println("failed to configure Ethernet using DHCP");
+    if (Ethernet.hardwareStatus() == EthernetNoHardware) {
+      while (true) {
+        Serial.println("Ethernet shield not found");
+        delay(1000);
+      }
+    }
+    if (Ethernet.linkStatus() == LinkOFF) {
+      Serial.println("Ethernet cable not connected");
+    }
+  }
+  sntp.set_poll_exponent_range(4, 6);
+  sntp.set_poll_callback(poll_finished);
+  // fast initial synchronization (about 2 s) without blocking setup()
+  sntp.begin_iburst();
+}
+
+void loop() {
+  sntp.update_async(true);
+  if (millis() - last_print >= 1000) {
+    last_print = millis();
+    Serial.print("epoch: ");
+    Serial.print(sntp.dget_epoch(), 3);
+    Serial.print(" synchronized: ");
+    Serial.println(sntp.is_synchronized());
+  }
+  // do other work here
+}
@@ -0,0 +1,71 @@
+/*
+  precise_sntp example
+
+  This example gets the time from an ntp server and serves the local clock
+  to the clients in the local network (e. g. sensors without access to the
+  internet). The server uses its own UDP instance listening on port 123.
+
+  Author: Daniel Mohr
+  Date: 2026-10-17
+*/
+
+#include <Ethernet.h>
+#include <EthernetUdp.h>
+
+#include <precise_sntp.h>
+#include <precise_sntp_server.h>
+
+#define SERIAL_BAUD_RATE 115200
+#define SERIAL_TIMEOUT 1000
+uint8_t mac[] = {0x02, 0x74, 0x72, 0x69, 0x67, 0x00};
+
+EthernetUDP udp;
+EthernetUDP server_udp;
+
+precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+precise_sntp_server server(server_udp, sntp);
+
+unsigned long last_print = 0;
+
+void setup() {
+  Serial.begin(SERIAL_BAUD_RATE);
+  Serial.setTimeout(SERIAL_TIMEOUT);
+  while (!Serial);
+  Serial.println("-- start --");
+  Ethernet.init(5);
+  if (Ethernet.begin(mac) == 0) {
+    Serial.println("failed to configure Ethernet using DHCP");
+    if (Ethernet.hardwareStatus() == EthernetNoHardware) {
+      while (true) {
+        Serial.println("Ethernet shield not found");
+        delay(1000);
+      }
+    }
+    if (Ethernet.linkStatus() == LinkOFF) {
+      Serial.println("Ethernet cable not connected");
+    }
+  }
+  sntp.begin_iburst();
+  if (!server.begin()) {
+    Serial.println("cannot open port 123");
+  }
+  // at most one request per client and second
+  server.set_rate_limit(1000);
+}
+
+void loop() {
+  sntp.update_async(true);
+  server.service();
+  if (millis() - last_print >= 10000) {
+    last_print = millis();
+    const struct precise_sntp_server_statistics stat = server.get_statistics();
+    Serial.print("stratum: ");
+    Serial.print(sntp.get_stratum() + 1);
+    Serial.print(" requests: ");
+    Serial.print(stat.requests);
+    Serial.print(" answers: ");
+    Serial.print(stat.answers);
+    Serial.print(" rate limited: ");
+    Serial.println(stat.rate_limited);
+  }
+}
@@ -0,0 +1,198 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Fuzz target of the parsing of ntp answers: the input is checked by
+  precise_sntp_ntp_packet_view (src/precise_sntp_ntp_packet_view.h) and
+  given as answers to the polls of precise_sntp, so the clock filter and
+  the discipline see hostile values, too.
+
+  Input: a flag byte followed by packets of 48 bytes (a shorter rest is
+  only given to the view). If bit 0 of the flags is set, the origin
+  timestamp of each answer is replaced by the transmit timestamp of the
+  request, so the checks after the origin check are reached.
+
+  With libFuzzer (clang), in the root directory of the library:
+
+    clang++ -g -O1 -fsanitize=fuzzer,address,undefined -I extras/posix \
+      -I src -o ntp_packet_fuzzer extras/fuzz/ntp_packet_fuzzer.cpp \
+      src/precise_sntp*.cpp
+    ./ntp_packet_fuzzer
+
+  Without libFuzzer (e. g. g++) NTP_PACKET_FUZZER_MAIN adds a main()
+  running the given number of mutated valid answers:
+
+    g++ -g -O1 -fsanitize=address,undefined -DNTP_PACKET_FUZZER_MAIN \
+      -I extras/posix -I src -o ntp_packet_fuzzer \
+      extras/fuzz/ntp_packet_fuzzer.cpp src/precise_sntp*.cpp
+    ./ntp_packet_fuzzer 100000
+*/
+
+#include <Arduino.h>
+#include <Udp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <precise_sntp.h>
+#include <precise_sntp_ntp_packet_view.h>
+#include <precise_sntp_xorshift32.h>
+
+#define FUZZ_MAX_POLLS 16
+
+/*
+  UDP driver answering each request with the next packet of the input
+*/
+class fuzz_udp : public UDP {
+ public:
+  const uint8_t *data = NULL;
+  size_t size = 0;
+  bool echo_origin = false;
+
+  uint8_t begin(uint16_t) {
+    return 1;
+  }
+  int beginPacket(IPAddress, uint16_t) {
+    return 1;
+  }
+  int beginPacket(const char*, uint16_t) {
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t size) {
+    memcpy(_request, buffer,
+	   (size < NTP_PACKET_VIEW_SIZE) ? size : NTP_PACKET_VIEW_SIZE);
+    return size;
+  }
+  int endPacket() {
+    _answer = true;
+    return 1;
+  }
+  int parsePacket() {
+    return (_answer && (size >= NTP_PACKET_VIEW_SIZE)) ?
+      NTP_PACKET_VIEW_SIZE : 0;
+  }
+  int read(unsigned char* buffer, size_t len) {
+    if (len > size) {
+      len = size;
+    }
+    memcpy(buffer, data, len);
+    if (echo_origin && (len >= NTP_PACKET_VIEW_SIZE)) {
+      memcpy(buffer + NTP_PACKET_VIEW_ORG, _request + NTP_PACKET_VIEW_XMT,
+	     8);
+    }
+    data += len;
+    size -= len;
+    _answer = false;
+    return (int) len;
+  }
+  int read(char* buffer, size_t len) {
+    return read((unsigned char*) buffer, len);
+  }
+  IPAddress remoteIP() {
+    return IPAddress(192, 168, 178, 1);
+  }
+  uint16_t remotePort() {
+    return 123;
+  }
+
+ private:
+  uint8_t _request[NTP_PACKET_VIEW_SIZE] = {};
+  bool _answer = false;
+};
+
+/*
+  reads all fields and runs all checks of the view
+*/
+static void fuzz_view(const uint8_t *data, size_t size) {
+  uint8_t packet[NTP_PACKET_VIEW_SIZE] = {};
+  memcpy(packet, data, (size < NTP_PACKET_VIEW_SIZE) ? size :
+	 NTP_PACKET_VIEW_SIZE);
+  const precise_sntp_ntp_packet_view view(packet);
+  // the origin timestamp of the packet is the second request
+  struct ntp_timestamp_format_struct xmt[2] = {view.org(), view.org()};
+  xmt[0].fraction ^= 1;
+  uint8_t index;
+  uint8_t ret =
+    view.check(size, NTP_PACKET_VIEW_MODE_SERVER, xmt, 2, &index);
+  if ((ret == 0) && ((index != 1) || (view.mode() != 4) ||
+		     (view.stratum() == 0) || (view.stratum() > 15))) {
+    abort();
+  }
+  ret = view.check(size, NTP_PACKET_VIEW_MODE_BROADCAST, NULL, 0, &index);
+  if ((ret == 0) && (view.mode() != 5)) {
+    abort();
+  }
+  volatile uint32_t sum = view.leap() + view.version() + view.poll() +
+    (uint8_t) view.precision() + view.rootdelay() + view.rootdisp() +
+    view.refid()[0] + view.reftime().seconds + view.rec().fraction +
+    view.xmt().seconds;
+  (void) sum;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size < 1) {
+    return 0;
+  }
+  fuzz_view(data + 1, size - 1);
+  fuzz_udp udp;
+  udp.echo_origin = (data[0] & 1) != 0;
+  udp.data = data + 1;
+  udp.size = size - 1;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  for (uint8_t i = 0;
+       (i < FUZZ_MAX_POLLS) && (udp.size >= NTP_PACKET_VIEW_SIZE); i++) {
+    if (!sntp.begin_poll()) {
+      break;
+    }
+    uint8_t ret = sntp.service(); // sends the request
+    if (ret == PRECISE_SNTP_POLL_PENDING) {
+      ret = sntp.service(); // reads the answer
+    }
+    while (ret == PRECISE_SNTP_POLL_PENDING) {
+      if (udp.size < NTP_PACKET_VIEW_SIZE) {
+	// no more answers, the request would run into the timeout
+	return 0;
+      }
+      ret = sntp.service();
+    }
+  }
+  sntp.get_local_clock();
+  sntp.tget_epoch_with_error();
+  return 0;
+}
+
+#ifdef NTP_PACKET_FUZZER_MAIN
+int main(int argc, char *argv[]) {
+  const unsigned long runs = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000;
+  uint32_t state = 0x12345678;
+  // a valid answer: version 4, mode 4, stratum 1, some timestamps
+  uint8_t answer[NTP_PACKET_VIEW_SIZE] = {
+    0x24, 1, 6, 0xEC, 0, 0, 0, 0x10, 0, 0, 0, 0x20, 'G', 'P', 'S', 0,
+    0xEC, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0xEC, 0, 0, 1, 0, 0, 0, 0, 0xEC, 0, 0, 1, 0, 0x10, 0, 0};
+  uint8_t input[1 + 4 * NTP_PACKET_VIEW_SIZE];
+  for (unsigned long run = 0; run < runs; run++) {
+    input[0] = (uint8_t) precise_sntp_xorshift32(&state);
+    for (uint8_t p = 0; p < 4; p++) {
+      memcpy(input + 1 + p * NTP_PACKET_VIEW_SIZE, answer,
+	     NTP_PACKET_VIEW_SIZE);
+    }
+    // flip some bits or set some bytes randomly
+    const uint8_t mutations = precise_sntp_xorshift32(&state) % 8;
+    for (uint8_t m = 0; m < mutations; m++) {
+      const uint32_t r = precise_sntp_xorshift32(&state);
+      const size_t i = 1 + (r >> 8) % (sizeof(input) - 1);
+      if (r & 0x80) {
+	input[i] = (uint8_t) r;
+      } else {
+	input[i] ^= (uint8_t) (1 << (r & 7));
+      }
+    }
+    const size_t size = 1 + precise_sntp_xorshift32(&state) % sizeof(input);
+    LLVMFuzzerTestOneInput(input, size);
+  }
+  printf("%lu runs done\n", runs);
+  return 0;
+}
+#endif
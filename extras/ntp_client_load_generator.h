@@ -0,0 +1,167 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Host-side load generator for the unittests (arduino_ci) of the server
+  (see src/precise_sntp_server.h).
+
+  ntp_client_load_generator implements the UDP interface (see udp_mock.h)
+  for the server: request() queues a client request, parsePacket() and
+  read() deliver it to the server and the answer written by the server is
+  checked and kept in last_answer.
+
+  Example:
+
+  #include <Arduino.h>
+  #include <ArduinoUnitTests.h>
+  #include <precise_sntp.h>
+  #include <precise_sntp_server.h>
+  #include "../extras/ntp_server_simulator.h"
+  #include "../extras/ntp_client_load_generator.h"
+  unittest(test) {
+    ntp_server_simulator udp;
+    precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+    ntp_client_load_generator clients;
+    precise_sntp_server server(clients, sntp);
+    sntp.update();
+    clients.request(IPAddress(192, 168, 1, 10));
+    assertEqual(1, server.service());
+  }
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <Udp.h>
+
+#define NTP_CLIENT_LOAD_GENERATOR_PACKET_SIZE 48
+#define NTP_CLIENT_LOAD_GENERATOR_QUEUE 64
+
+class ntp_client_load_generator : public UDP {
+ public:
+  uint32_t requests = 0; // requests queued
+  uint32_t answers = 0; // answers sent by the server
+  uint32_t bad_answers = 0; // answers not matching the request
+  uint8_t last_answer[NTP_CLIENT_LOAD_GENERATOR_PACKET_SIZE];
+  IPAddress last_answer_ip; // address the last answer was sent to
+
+  /*
+    queues a request of the client ip with the given version and mode,
+    returns false if the queue is full
+  */
+  bool request(IPAddress ip, uint8_t version = 4, uint8_t mode = 3) {
+    if (_queued == NTP_CLIENT_LOAD_GENERATOR_QUEUE) {
+      return false;
+    }
+    struct queued_request *r =
+      &(_queue[(_first + _queued) % NTP_CLIENT_LOAD_GENERATOR_QUEUE]);
+    memset(r->data, 0, NTP_CLIENT_LOAD_GENERATOR_PACKET_SIZE);
+    r->data[0] = (uint8_t) ((3 << 6) | (version << 3) | mode);
+    r->data[2] = 6; // poll
+    // unique transmit timestamp to match the answer
+    const uint32_t id = ++requests;
+    memcpy(r->data + 40, &id, 4);
+    r->ip = ip;
+    _queued++;
+    return true;
+  }
+
+  uint8_t begin(uint16_t port) {
+    (void) port;
+    return 1;
+  }
+
+  int beginPacket(IPAddress ip, uint16_t port) {
+    (void) port;
+    _answer_ip = ip;
+    _answer_size = 0;
+    return 1;
+  }
+
+  int beginPacket(const char *host, uint16_t port) {
+    (void) host;
+    (void) port;
+    return 0;
+  }
+
+  size_t write(const uint8_t *buffer, size_t size) {
+    if (_answer_size + size > NTP_CLIENT_LOAD_GENERATOR_PACKET_SIZE) {
+      size = NTP_CLIENT_LOAD_GENERATOR_PACKET_SIZE - _answer_size;
+    }
+    memcpy(last_answer + _answer_size, buffer, size);
+    _answer_size += size;
+    return size;
+  }
+
+  int endPacket() {
+    answers++;
+    last_answer_ip = _answer_ip;
+    // the origin timestamp has to be the transmit timestamp of the request
+    if ((_answer_size != NTP_CLIENT_LOAD_GENERATOR_PACKET_SIZE) ||
+	(!(_answer_ip == _current.ip)) ||
+	(memcmp(last_answer + 24, _current.data + 40, 8) != 0) ||
+	((last_answer[0] & 0x07) != 4)) {
+      bad_answers++;
+    }
+    return 1;
+  }
+
+  int parsePacket() {
+    if (_queued == 0) {
+      return 0;
+    }
+    _current = _queue[_first];
+    _first = (_first + 1) % NTP_CLIENT_LOAD_GENERATOR_QUEUE;
+    _queued--;
+    _available = true;
+    return NTP_CLIENT_LOAD_GENERATOR_PACKET_SIZE;
+  }
+
+  int read(unsigned char* buffer, size_t len) {
+    if (!_available) {
+      return 0;
+    }
+    if (len > NTP_CLIENT_LOAD_GENERATOR_PACKET_SIZE) {
+      len = NTP_CLIENT_LOAD_GENERATOR_PACKET_SIZE;
+    }
+    memcpy(buffer, _current.data, len);
+    _available = false;
+    return len;
+  }
+
+  int read(char* buffer, size_t len) {
+    return read((unsigned char*) buffer, len);
+  }
+
+  IPAddress remoteIP() {
+    return _current.ip;
+  }
+
+  uint16_t remotePort() {
+    return 123;
+  }
+
+  /*
+    returns the 32 bit value at offset of last_answer
+    (network byte order converted to host byte order)
+  */
+  uint32_t answer32(uint8_t offset) {
+    return (((uint32_t) last_answer[offset]) << 24) |
+      (((uint32_t) last_answer[offset + 1]) << 16) |
+      (((uint32_t) last_answer[offset + 2]) << 8) |
+      ((uint32_t) last_answer[offset + 3]);
+  }
+
+ private:
+  struct queued_request {
+    IPAddress ip;
+    uint8_t data[NTP_CLIENT_LOAD_GENERATOR_PACKET_SIZE];
+  };
+  struct queued_request _queue[NTP_CLIENT_LOAD_GENERATOR_QUEUE];
+  uint8_t _first = 0;
+  uint8_t _queued = 0;
+  struct queued_request _current;
+  bool _available = false;
+  IPAddress _answer_ip;
+  size_t _answer_size = 0;
+};
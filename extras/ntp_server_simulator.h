@@ -0,0 +1,360 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Host-side network simulator for the unittests (arduino_ci).
+
+  ntp_server_simulator implements the UDP interface (see udp_mock.h) and
+  answers the requests like a (scripted) ntp server. The time is controlled
+  by the arduino_ci godmode: micros() and millis() of the simulated board
+  are GODMODE()->micros. Every call of parsePacket() advances this clock
+  by poll_step_us, so a busy waiting client does not wait forever.
+
+  The simulated board has a local oscillator with an error of drift_ppm
+  compared to the true time of the server. Further latency, asymmetry,
+  jitter, loss and not synchronized servers (KoD) can be injected.
+
+  Several servers can be simulated: server(ip) gives the parameters of the
+  server with the address ip. The address of a request selects the server.
+  Requests to other addresses or names are answered using parameter.
+  broadcast(ip) lets the server ip send a broadcast packet (mode 5).
+
+  Example:
+
+  #include <Arduino.h>
+  #include <ArduinoUnitTests.h>
+  #include <precise_sntp.h>
+  #include "../extras/ntp_server_simulator.h"
+  unittest(test) {
+    ntp_server_simulator udp;
+    udp.parameter.latency_up_us = 5000;
+    precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+    assertEqual(0, sntp.force_update());
+  }
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <Udp.h>
+
+#include <precise_sntp.h>
+
+#define NTP_SERVER_SIMULATOR_PACKET_SIZE 48
+#define NTP_SERVER_SIMULATOR_QUEUE 16
+#define NTP_SERVER_SIMULATOR_SERVERS 8
+
+struct ntp_server_simulator_parameter {
+  uint32_t latency_up_us = 500; // network latency client -> server
+  uint32_t latency_down_us = 500; // network latency server -> client
+  uint32_t jitter_us = 0; // maximal additional random latency (each way)
+  uint32_t processing_us = 50; // time between receive and transmit
+  uint8_t loss_percent = 0; // probability to loose a request or reply
+  double drift_ppm = 0.0; // error of the local oscillator of the board
+  uint8_t stratum = 2; // stratum 0 gives a kiss-o'-death packet
+  char refid[4] = {'G', 'P', 'S', 0}; // reference id (kiss code)
+  uint8_t leap = 0; // leap indicator
+  uint8_t poll = 6; // poll exponent announced by the server
+  int8_t precision = -20; // precision of the server
+  uint32_t rootdelay = 0; // root delay in units of 2^-16 s (ntp short format)
+  uint32_t rootdisp = 0; // root dispersion in units of 2^-16 s
+  bool bogus_origin = false; // answer with a wrong origin timestamp
+  bool silent = false; // do not answer at all
+  int32_t offset_us = 0; // error of the clock of the server (falseticker)
+  uint32_t poll_step_us = 10; // time advancing by each parsePacket()
+  uint32_t begin_packet_us = 0; // time needed by beginPacket() (e. g. dns)
+  uint32_t requests = 0; // requests sent to this server
+};
+
+class ntp_server_simulator : public UDP {
+ public:
+  struct ntp_server_simulator_parameter parameter;
+  uint32_t packets_sent = 0; // requests sent by the client
+  uint32_t packets_received = 0; // replies read by the client
+  uint32_t packets_lost = 0; // requests or replies lost
+  bool fail_begin = false; // begin() fails
+  bool fail_begin_packet = false; // beginPacket() fails
+  unsigned long last_arrival_us = 0; // micros() when the last reply arrived
+  uint32_t begin_packet_by_name = 0; // calls of beginPacket() with a name
+
+  /*
+    true_start_seconds is the true time (ntp seconds) at micros() == 0
+  */
+  ntp_server_simulator(uint32_t true_start_seconds = 3900000000UL,
+		       uint32_t seed = 1) {
+    _true_start = ((uint64_t) true_start_seconds) << 32;
+    _random_state = seed ? seed : 1;
+  }
+
+  /*
+    returns the true time in ntp timestamp format (units of 2^-32 s)
+    for a local micros() value
+  */
+  uint64_t true_time(unsigned long local_us) {
+    // local_us runs with (1 + drift) compared to the true time
+    const double units = ((double) local_us) * 4294.967296 /
+      (1.0 + parameter.drift_ppm * 1e-6);
+    return _true_start + (uint64_t) (units + 0.5);
+  }
+
+  /*
+    returns the error of a local clock reading taken now
+    in units of 2^-32 s (positive: local clock is ahead)
+  */
+  int64_t clock_error(struct ntp_timestamp_format_struct local) {
+    const uint64_t l = (((uint64_t) local.seconds) << 32) + local.fraction;
+    return (int64_t) (l - true_time(micros()));
+  }
+
+  /*
+    returns the parameters of the server with the address ip,
+    at first call they are copied from parameter
+  */
+  struct ntp_server_simulator_parameter &server(IPAddress ip) {
+    for (uint8_t i = 0; i < _servers; i++) {
+      if (_server_ip[i] == ip) {
+	return _server_parameter[i];
+      }
+    }
+    if (_servers == NTP_SERVER_SIMULATOR_SERVERS) {
+      return parameter;
+    }
+    _server_ip[_servers] = ip;
+    _server_parameter[_servers] = parameter;
+    _server_parameter[_servers].requests = 0;
+    return _server_parameter[_servers++];
+  }
+
+  /*
+    advances the clock of the simulated board by us microseconds
+  */
+  void advance(unsigned long us) {
+    GODMODE()->micros += us;
+  }
+
+  uint8_t begin(uint16_t port) {
+    (void) port;
+    return fail_begin ? 0 : 1;
+  }
+
+  int beginPacket(IPAddress ip, uint16_t port) {
+    (void) port;
+    _request_size = 0;
+    _current = &parameter;
+    _current_ip = ip;
+    for (uint8_t i = 0; i < _servers; i++) {
+      if (_server_ip[i] == ip) {
+	_current = &(_server_parameter[i]);
+      }
+    }
+    advance(_current->begin_packet_us);
+    return fail_begin_packet ? 0 : 1;
+  }
+
+  int beginPacket(const char *host, uint16_t port) {
+    (void) host;
+    (void) port;
+    _request_size = 0;
+    _current = &parameter;
+    begin_packet_by_name++;
+    _current_ip = IPAddress();
+    advance(_current->begin_packet_us);
+    return fail_begin_packet ? 0 : 1;
+  }
+
+  size_t write(const uint8_t *buffer, size_t size) {
+    if (_request_size + size > NTP_SERVER_SIMULATOR_PACKET_SIZE) {
+      size = NTP_SERVER_SIMULATOR_PACKET_SIZE - _request_size;
+    }
+    memcpy(_request + _request_size, buffer, size);
+    _request_size += size;
+    return size;
+  }
+
+  int endPacket() {
+    packets_sent++;
+    _current->requests++;
+    if (_current->silent || lost()) {
+      return 1;
+    }
+    const unsigned long now = micros();
+    const unsigned long received =
+      now + _current->latency_up_us + random_us(_current->jitter_us);
+    const unsigned long transmitted = received + _current->processing_us;
+    const unsigned long arrival =
+      transmitted + _current->latency_down_us + random_us(_current->jitter_us);
+    if (lost()) {
+      return 1;
+    }
+    // the clock of the server differs by offset_us from the true time
+    const int64_t offset =
+      ((int64_t) _current->offset_us) * 4294967296LL / 1000000;
+    for (uint8_t i = 0; i < NTP_SERVER_SIMULATOR_QUEUE; i++) {
+      if (!_queue[i].used) {
+	_queue[i].used = true;
+	_queue[i].arrival = arrival;
+	_queue[i].ip = _current_ip;
+	build_reply(_queue[i].data, true_time(received) + offset,
+		    true_time(transmitted) + offset, 4);
+	return 1;
+      }
+    }
+    packets_lost++; // queue is full
+    return 1;
+  }
+
+  /*
+    the server with the address ip sends a broadcast packet (mode 5) now,
+    it arrives after the latency server -> client
+  */
+  void broadcast(IPAddress ip) {
+    _current = &(server(ip));
+    _current_ip = ip;
+    if (_current->silent || lost()) {
+      return;
+    }
+    const unsigned long now = micros();
+    const unsigned long arrival =
+      now + _current->latency_down_us + random_us(_current->jitter_us);
+    const int64_t offset =
+      ((int64_t) _current->offset_us) * 4294967296LL / 1000000;
+    for (uint8_t i = 0; i < NTP_SERVER_SIMULATOR_QUEUE; i++) {
+      if (!_queue[i].used) {
+	_queue[i].used = true;
+	_queue[i].arrival = arrival;
+	_queue[i].ip = ip;
+	build_reply(_queue[i].data, 0, true_time(now) + offset, 5);
+	return;
+      }
+    }
+    packets_lost++; // queue is full
+  }
+
+  int parsePacket() {
+    advance(parameter.poll_step_us);
+    const unsigned long now = micros();
+    int8_t next = -1;
+    for (uint8_t i = 0; i < NTP_SERVER_SIMULATOR_QUEUE; i++) {
+      if (_queue[i].used && (_queue[i].arrival <= now) &&
+	  ((next < 0) || (_queue[i].arrival < _queue[next].arrival))) {
+	next = i;
+      }
+    }
+    if (next < 0) {
+      _reply_available = false;
+      return 0;
+    }
+    memcpy(_reply, _queue[next].data, NTP_SERVER_SIMULATOR_PACKET_SIZE);
+    _queue[next].used = false;
+    last_arrival_us = _queue[next].arrival;
+    _remote_ip = _queue[next].ip;
+    _reply_available = true;
+    return NTP_SERVER_SIMULATOR_PACKET_SIZE;
+  }
+
+  int read(unsigned char* buffer, size_t len) {
+    if (!_reply_available) {
+      return 0;
+    }
+    if (len > NTP_SERVER_SIMULATOR_PACKET_SIZE) {
+      len = NTP_SERVER_SIMULATOR_PACKET_SIZE;
+    }
+    memcpy(buffer, _reply, len);
+    _reply_available = false;
+    packets_received++;
+    return len;
+  }
+
+  int read(char* buffer, size_t len) {
+    return read((unsigned char*) buffer, len);
+  }
+
+  IPAddress remoteIP() {
+    return _remote_ip;
+  }
+
+  uint16_t remotePort() {
+    return 123;
+  }
+
+  /*
+    pseudo random numbers (xorshift32), reproducible by the seed
+  */
+  uint32_t random32() {
+    _random_state ^= _random_state << 13;
+    _random_state ^= _random_state >> 17;
+    _random_state ^= _random_state << 5;
+    return _random_state;
+  }
+
+ private:
+  struct queued_reply {
+    bool used = false;
+    unsigned long arrival = 0;
+    IPAddress ip; // address of the server
+    uint8_t data[NTP_SERVER_SIMULATOR_PACKET_SIZE];
+  };
+  uint64_t _true_start;
+  uint32_t _random_state;
+  uint8_t _request[NTP_SERVER_SIMULATOR_PACKET_SIZE];
+  size_t _request_size = 0;
+  struct queued_reply _queue[NTP_SERVER_SIMULATOR_QUEUE];
+  uint8_t _reply[NTP_SERVER_SIMULATOR_PACKET_SIZE];
+  bool _reply_available = false;
+  IPAddress _server_ip[NTP_SERVER_SIMULATOR_SERVERS];
+  struct ntp_server_simulator_parameter
+  _server_parameter[NTP_SERVER_SIMULATOR_SERVERS];
+  uint8_t _servers = 0;
+  struct ntp_server_simulator_parameter *_current = &parameter;
+  IPAddress _current_ip; // address of the current request
+  IPAddress _remote_ip; // address of the server of the last reply
+
+  bool lost() {
+    if ((_current->loss_percent > 0) &&
+	(random32() % 100 < _current->loss_percent)) {
+      packets_lost++;
+      return true;
+    }
+    return false;
+  }
+
+  uint32_t random_us(uint32_t max_us) {
+    return (max_us > 0) ? (random32() % (max_us + 1)) : 0;
+  }
+
+  static void put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t) (v >> 24);
+    p[1] = (uint8_t) (v >> 16);
+    p[2] = (uint8_t) (v >> 8);
+    p[3] = (uint8_t) v;
+  }
+
+  static void put64(uint8_t *p, uint64_t v) {
+    put32(p, (uint32_t) (v >> 32));
+    put32(p + 4, (uint32_t) v);
+  }
+
+  void build_reply(uint8_t *reply, uint64_t rec, uint64_t xmt, uint8_t mode) {
+    memset(reply, 0, NTP_SERVER_SIMULATOR_PACKET_SIZE);
+    // version 4, mode 4 (server) or 5 (broadcast)
+    reply[0] = (uint8_t) ((_current->leap << 6) | (4 << 3) | mode);
+    reply[1] = _current->stratum;
+    reply[2] = _current->poll;
+    reply[3] = (uint8_t) _current->precision;
+    put32(reply + 4, _current->rootdelay);
+    put32(reply + 8, _current->rootdisp);
+    memcpy(reply + 12, _current->refid, 4);
+    put64(reply + 16, xmt - (((uint64_t) 16) << 32)); // reftime
+    if (mode == 5) {
+      // no request: origin and receive timestamp are 0
+      put64(reply + 40, xmt);
+      return;
+    }
+    memcpy(reply + 24, _request + 40, 8); // org = xmt of the request
+    if (_current->bogus_origin) {
+      reply[31] ^= 0x01;
+    }
+    put64(reply + 32, rec);
+    put64(reply + 40, xmt);
+  }
+};
@@ -0,0 +1,129 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Minimal stand-in of Arduino.h to use precise_sntp on Linux (or another
+  POSIX system) together with the UDP implementation in posix_udp.h.
+
+  millis() and micros() are based on CLOCK_MONOTONIC (usually the time
+  since the boot), so they are not changed by setting the system time.
+  As on the Arduino they overflow with unsigned long (after about 49 days
+  or 71 minutes if unsigned long has 32 bit).
+
+  Example (compile with -I extras/posix -I src):
+
+  #include <Arduino.h>
+  #include <posix_udp.h>
+  #include <precise_sntp.h>
+  int main() {
+    posix_udp udp;
+    precise_sntp sntp(udp, "pool.ntp.org");
+    ...
+  }
+*/
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <cstdlib>
+
+#include <IPAddress.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+using std::abs;
+
+/*
+  returns CLOCK_MONOTONIC in nanoseconds
+*/
+static inline uint64_t posix_monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec) * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static inline unsigned long millis() {
+  return (unsigned long) (posix_monotonic_ns() / 1000000ULL);
+}
+
+static inline unsigned long micros() {
+  return (unsigned long) (posix_monotonic_ns() / 1000ULL);
+}
+
+static inline void delay(unsigned long ms) {
+  struct timespec ts;
+  ts.tv_sec = (time_t) (ms / 1000);
+  ts.tv_nsec = (long) (ms % 1000) * 1000000L;
+  while (nanosleep(&ts, &ts) != 0) {
+    // interrupted by a signal, sleep the remaining time
+  }
+}
+
+static inline void delayMicroseconds(unsigned int us) {
+  struct timespec ts;
+  ts.tv_sec = (time_t) (us / 1000000);
+  ts.tv_nsec = (long) (us % 1000000) * 1000L;
+  while (nanosleep(&ts, &ts) != 0) {
+    // interrupted by a signal, sleep the remaining time
+  }
+}
+
+/*
+  Serial writes to stdout (only used with PRECISE_SNTP_DEBUG).
+*/
+class posix_serial {
+ public:
+  void begin(unsigned long baud) {
+    (void) baud;
+  }
+  void print(const char *s) {
+    fputs(s, stdout);
+  }
+  void print(char c) {
+    putchar(c);
+  }
+  void print(unsigned char v) {
+    printf("%u", (unsigned int) v);
+  }
+  void print(int v) {
+    printf("%d", v);
+  }
+  void print(unsigned int v) {
+    printf("%u", v);
+  }
+  void print(long v) {
+    printf("%ld", v);
+  }
+  void print(unsigned long v) {
+    printf("%lu", v);
+  }
+  void print(long long v) {
+    printf("%lld", v);
+  }
+  void print(unsigned long long v) {
+    printf("%llu", v);
+  }
+  void print(double v, int digits = 2) {
+    printf("%.*f", digits, v);
+  }
+  template <class T> void println(T v) {
+    print(v);
+    putchar('\n');
+  }
+  void println(double v, int digits) {
+    print(v, digits);
+    putchar('\n');
+  }
+  void println() {
+    putchar('\n');
+  }
+};
+
+static posix_serial Serial __attribute__((unused));
@@ -0,0 +1,58 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Minimal stand-in of the Arduino IPAddress (IPv4 only) for the POSIX
+  backend, see Arduino.h and posix_udp.h in this directory.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+class IPAddress {
+ public:
+  IPAddress() {
+    memset(_address, 0, 4);
+  }
+
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    _address[0] = a;
+    _address[1] = b;
+    _address[2] = c;
+    _address[3] = d;
+  }
+
+  /*
+    address in network byte order (as in struct in_addr)
+  */
+  IPAddress(uint32_t address) {
+    memcpy(_address, &address, 4);
+  }
+
+  operator uint32_t() const {
+    uint32_t address;
+    memcpy(&address, _address, 4);
+    return address;
+  }
+
+  bool operator==(const IPAddress &other) const {
+    return memcmp(_address, other._address, 4) == 0;
+  }
+
+  bool operator!=(const IPAddress &other) const {
+    return !(*this == other);
+  }
+
+  uint8_t operator[](int index) const {
+    return _address[index];
+  }
+
+  uint8_t& operator[](int index) {
+    return _address[index];
+  }
+
+ private:
+  uint8_t _address[4];
+};
@@ -0,0 +1,13 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  The UDP interface of the Arduino for the POSIX backend: the part used
+  by precise_sntp is the same as in ../udp_mock.h.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "../udp_mock.h"
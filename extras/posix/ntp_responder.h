@@ -0,0 +1,183 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Stand-in ntp server on a local port for the loopback tests of
+  posix_udp.h (test/unit_test_posix_loopback.cpp): it serves
+  CLOCK_REALTIME plus a given offset with stratum 1.
+
+  The receive timestamp T2 is the time the kernel received the request
+  (SO_TIMESTAMPNS) and the transmit timestamp T3 is taken directly before
+  sendto(). So the time until service() is called does not count as
+  network delay, as for a real server.
+
+  Example:
+
+  #include <Arduino.h>
+  #include <posix_udp.h>
+  #include <ntp_responder.h>
+  #include <precise_sntp.h>
+  posix_ntp_responder responder;
+  posix_udp udp;
+  precise_sntp sntp(udp, IPAddress(127, 0, 0, 1));
+  responder.begin(12300);
+  udp.set_destination_port(12300);
+  sntp.begin_poll();
+  while (sntp.service() == PRECISE_SNTP_POLL_PENDING) {
+    responder.service();
+  }
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <precise_sntp.h>
+#include <precise_sntp_ntp_packet.h>
+
+class posix_ntp_responder {
+ public:
+  uint32_t requests = 0; // requests received
+  uint32_t answers = 0; // answers sent
+
+  ~posix_ntp_responder() {
+    if (_socket >= 0) {
+      close(_socket);
+    }
+  }
+
+  /*
+    Opens the port for the requests.
+
+    returns true on success
+  */
+  bool begin(uint16_t port) {
+    _socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (_socket < 0) {
+      return false;
+    }
+    const int on = 1;
+    setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#ifdef SO_TIMESTAMPNS
+    setsockopt(_socket, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+#endif
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    local.sin_port = htons(port);
+    return (bind(_socket, (struct sockaddr*) &local, sizeof(local)) == 0) &&
+      (fcntl(_socket, F_SETFL, fcntl(_socket, F_GETFL, 0) | O_NONBLOCK) == 0);
+  }
+
+  /*
+    Set the offset in nanoseconds of the served clock to CLOCK_REALTIME.
+  */
+  void set_offset(int64_t offset) {
+    _offset = offset;
+  }
+
+  /*
+    Returns the served clock (CLOCK_REALTIME plus the offset) in units of
+    2^-32 seconds since 1900.
+  */
+  uint64_t now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return timespec2clock(&ts);
+  }
+
+  /*
+    Answers all waiting requests.
+
+    returns the number of answers sent
+  */
+  uint8_t service() {
+    uint8_t n = 0;
+    while (_socket >= 0) {
+      union ntp_packet_union packet;
+      struct sockaddr_in remote;
+      struct iovec iov;
+      iov.iov_base = packet.as_bytes;
+      iov.iov_len = NTP_PACKET_SIZE;
+      union {
+	struct cmsghdr align;
+	uint8_t data[CMSG_SPACE(sizeof(struct timespec))];
+      } control;
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_name = &remote;
+      msg.msg_namelen = sizeof(remote);
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control.data;
+      msg.msg_controllen = sizeof(control.data);
+      const ssize_t size = recvmsg(_socket, &msg, MSG_DONTWAIT);
+      if (size <= 0) {
+	break;
+      }
+      requests++;
+      uint64_t rec = now();
+#ifdef SO_TIMESTAMPNS
+      for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c;
+	   c = CMSG_NXTHDR(&msg, c)) {
+	if ((c->cmsg_level == SOL_SOCKET) &&
+	    (c->cmsg_type == SCM_TIMESTAMPNS)) {
+	  struct timespec rx;
+	  memcpy(&rx, CMSG_DATA(c), sizeof(rx));
+	  rec = timespec2clock(&rx);
+	}
+      }
+#endif
+      if ((size != NTP_PACKET_SIZE) ||
+	  ((packet.as_ntp_packet.leap_version_mode & 0x07) != 3)) {
+	continue;
+      }
+      struct ntp_packet_struct *p = &(packet.as_ntp_packet);
+      p->org = p->xmt;
+      p->leap_version_mode = (4 << 3) | 4; // no warning, version 4, server
+      p->stratum = 1;
+      p->precision = (uint8_t) -20; // about 1 us
+      memset(&(p->rootdelay), 0, sizeof(p->rootdelay));
+      memset(&(p->rootdisp), 0, sizeof(p->rootdisp));
+      memcpy(p->refid, "LOCL", 4);
+      clock2timestamp(rec - (((uint64_t) 16) << 32), &(p->reftime));
+      clock2timestamp(rec, &(p->rec));
+      clock2timestamp(now(), &(p->xmt));
+      if (sendto(_socket, packet.as_bytes, NTP_PACKET_SIZE, 0,
+		 (struct sockaddr*) &remote, sizeof(remote)) == NTP_PACKET_SIZE) {
+	answers++;
+	n++;
+      }
+    }
+    return n;
+  }
+
+ private:
+  int _socket = -1;
+  int64_t _offset = 0;
+
+  uint64_t timespec2clock(const struct timespec *ts) {
+    const uint64_t seconds = ((uint64_t) ts->tv_sec) + 2208988800ULL;
+    const uint64_t fraction =
+      (((uint64_t) ts->tv_nsec) << 32) / 1000000000ULL;
+    const int64_t offset = (_offset / 1000000000LL) * 4294967296LL +
+      ((_offset % 1000000000LL) * 4294967296LL) / 1000000000LL;
+    return (seconds << 32) + fraction + (uint64_t) offset;
+  }
+
+  static void clock2timestamp(uint64_t clock,
+			      struct ntp_timestamp_format_struct *t) {
+    t->seconds = (uint32_t) (clock >> 32);
+    t->fraction = (uint32_t) clock;
+    ntp_timestamp_format_hton(t);
+  }
+};
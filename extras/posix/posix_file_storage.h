@@ -0,0 +1,76 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Storage of the state of precise_sntp (see precise_sntp::save_state() and
+  precise_sntp::load_state()) in a file on Linux. A write goes to a
+  temporary file, which replaces the file afterwards, so a crash during
+  the write keeps the old state.
+
+  Example:
+
+  #include <Arduino.h>
+  #include <posix_udp.h>
+  #include <posix_file_storage.h>
+  #include <precise_sntp.h>
+  posix_udp udp;
+  precise_sntp sntp(udp, "pool.ntp.org");
+  posix_file_storage storage("/var/lib/sntp_client/state");
+  sntp.load_state(storage);
+  ...
+  sntp.save_state(storage);
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+
+#include <precise_sntp_storage.h>
+
+// size of the buffer of the path (the path is truncated to fit)
+#ifndef POSIX_FILE_STORAGE_PATH_SIZE
+#define POSIX_FILE_STORAGE_PATH_SIZE 256
+#endif
+
+class posix_file_storage : public precise_sntp_storage {
+ public:
+  /*
+    path: file to store the state in (the temporary file is path.tmp)
+  */
+  posix_file_storage(const char *path) {
+    strncpy(_path, path, POSIX_FILE_STORAGE_PATH_SIZE - 1);
+    _path[POSIX_FILE_STORAGE_PATH_SIZE - 1] = 0;
+  }
+
+  bool read(uint8_t *buffer, size_t size) {
+    FILE *f = fopen(_path, "rb");
+    if (f == NULL) {
+      return false;
+    }
+    const bool ret = (fread(buffer, 1, size, f) == size);
+    fclose(f);
+    return ret;
+  }
+
+  bool write(const uint8_t *buffer, size_t size) {
+    char tmp[POSIX_FILE_STORAGE_PATH_SIZE + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", _path);
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL) {
+      return false;
+    }
+    bool ret = (fwrite(buffer, 1, size, f) == size);
+    ret = (fclose(f) == 0) && ret;
+    if (ret) {
+      ret = (rename(tmp, _path) == 0);
+    }
+    if (!ret) {
+      remove(tmp);
+    }
+    return ret;
+  }
+
+ private:
+  char _path[POSIX_FILE_STORAGE_PATH_SIZE];
+};
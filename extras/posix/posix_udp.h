@@ -0,0 +1,309 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Implementation of the UDP interface (see ../udp_mock.h) with POSIX
+  sockets (IPv4), e. g. to use precise_sntp on a Linux gateway.
+
+  The socket is non-blocking and packets are received with recvmsg().
+  On Linux the kernel stores the time a packet was received
+  (SO_TIMESTAMPNS). receive_timestamp_hook() gives this time in ticks
+  (millis() or micros() if PRECISE_SNTP_USE_MICROS is defined), so the
+  receive time T4 does not contain the time until parsePacket() is called:
+
+    posix_udp udp;
+    precise_sntp sntp(udp, "pool.ntp.org");
+    sntp.set_receive_timestamp_hook(posix_udp::receive_timestamp_hook);
+
+  On Linux compile with -I extras/posix -I src, so Arduino.h, IPAddress.h
+  and Udp.h of this directory are used. For the unittests (arduino_ci)
+  the mocked Arduino.h is used instead and the tests follow
+  CLOCK_MONOTONIC with GODMODE()->micros.
+
+  Example:
+
+  #include <Arduino.h>
+  #include <posix_udp.h>
+  #include <precise_sntp.h>
+  int main() {
+    posix_udp udp;
+    precise_sntp sntp(udp, "pool.ntp.org");
+    sntp.set_receive_timestamp_hook(posix_udp::receive_timestamp_hook);
+    while (true) {
+      if (sntp.update_async() == 0) {
+        printf("%f\n", sntp.dget_epoch());
+      }
+      delay(1);
+    }
+  }
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <Udp.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <precise_sntp.h>
+
+#define POSIX_UDP_BUFFER_SIZE 512
+
+class posix_udp : public UDP {
+ public:
+  posix_udp() {
+    memset(&_destination, 0, sizeof(_destination));
+    memset(&_remote, 0, sizeof(_remote));
+  }
+
+  ~posix_udp() {
+    stop();
+    if (last_received() == this) {
+      last_received() = NULL;
+    }
+  }
+
+  /*
+    Opens a non-blocking socket bound to port (0: any free port) on all
+    interfaces. If the socket is already bound to port, it is kept, so
+    waiting packets are not lost.
+
+    returns 1 on success and 0 on error
+  */
+  uint8_t begin(uint16_t port) {
+    if ((_socket >= 0) && (port == _port)) {
+      return 1;
+    }
+    stop();
+    _socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (_socket < 0) {
+      return 0;
+    }
+    const int on = 1;
+    setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(_socket, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+#ifdef SO_TIMESTAMPNS
+    // the kernel stores the receive time of each packet
+    setsockopt(_socket, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+#endif
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+    if ((bind(_socket, (struct sockaddr*) &local, sizeof(local)) != 0) ||
+	(fcntl(_socket, F_SETFL, fcntl(_socket, F_GETFL, 0) | O_NONBLOCK) !=
+	 0)) {
+      stop();
+      return 0;
+    }
+    _port = port;
+    return 1;
+  }
+
+  /*
+    Closes the socket.
+  */
+  void stop() {
+    if (_socket >= 0) {
+      close(_socket);
+    }
+    _socket = -1;
+    _size = 0;
+    _position = 0;
+  }
+
+  /*
+    Sends all packets to port instead of the port given to beginPacket()
+    (0, the default, uses the given port). precise_sntp always sends to
+    port 123, so this allows to use a local server on an unprivileged
+    port (e. g. for the tests).
+  */
+  void set_destination_port(uint16_t port) {
+    _destination_port = port;
+  }
+
+  int beginPacket(IPAddress ip, uint16_t port) {
+    memset(&_destination, 0, sizeof(_destination));
+    _destination.sin_family = AF_INET;
+    const uint8_t address[4] = {ip[0], ip[1], ip[2], ip[3]};
+    memcpy(&(_destination.sin_addr.s_addr), address, 4);
+    _destination.sin_port =
+      htons((_destination_port > 0) ? _destination_port : port);
+    _packet_size = 0;
+    return (_socket >= 0) ? 1 : 0;
+  }
+
+  /*
+    resolves host (IPv4) with getaddrinfo(), which blocks
+  */
+  int beginPacket(const char *host, uint16_t port) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo *result = NULL;
+    if ((getaddrinfo(host, NULL, &hints, &result) != 0) || (!result)) {
+      return 0;
+    }
+    const IPAddress ip =
+      sockaddr2ip((struct sockaddr_in*) result->ai_addr);
+    freeaddrinfo(result);
+    return beginPacket(ip, port);
+  }
+
+  size_t write(const uint8_t *buffer, size_t size) {
+    if (_packet_size + size > POSIX_UDP_BUFFER_SIZE) {
+      size = POSIX_UDP_BUFFER_SIZE - _packet_size;
+    }
+    memcpy(_packet + _packet_size, buffer, size);
+    _packet_size += size;
+    return size;
+  }
+
+  int endPacket() {
+    if (_socket < 0) {
+      return 0;
+    }
+    const ssize_t sent = sendto(_socket, _packet, _packet_size, 0,
+				(struct sockaddr*) &_destination,
+				sizeof(_destination));
+    return (sent == (ssize_t) _packet_size) ? 1 : 0;
+  }
+
+  /*
+    Receives the next waiting packet without blocking and stores the time
+    the kernel received it.
+
+    returns the size of the packet or 0 if no packet is waiting
+  */
+  int parsePacket() {
+    _size = 0;
+    _position = 0;
+    if (_socket < 0) {
+      return 0;
+    }
+    struct iovec iov;
+    iov.iov_base = _buffer;
+    iov.iov_len = POSIX_UDP_BUFFER_SIZE;
+    union {
+      struct cmsghdr align;
+      uint8_t data[CMSG_SPACE(sizeof(struct timespec))];
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &_remote;
+    msg.msg_namelen = sizeof(_remote);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data;
+    msg.msg_controllen = sizeof(control.data);
+    const ssize_t size = recvmsg(_socket, &msg, MSG_DONTWAIT);
+    if (size <= 0) {
+      return 0;
+    }
+    _size = (size_t) size;
+    // the age of the packet is measured with CLOCK_REALTIME (the clock of
+    // the kernel timestamp) and subtracted from the ticks now
+    _rx_valid = false;
+#ifdef SO_TIMESTAMPNS
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c;
+	 c = CMSG_NXTHDR(&msg, c)) {
+      if ((c->cmsg_level == SOL_SOCKET) &&
+	  (c->cmsg_type == SCM_TIMESTAMPNS)) {
+	struct timespec rx;
+	memcpy(&rx, CMSG_DATA(c), sizeof(rx));
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	const unsigned long ticks = PRECISE_SNTP_TICKS();
+	const int64_t age_ns =
+	  ((int64_t) (now.tv_sec - rx.tv_sec)) * 1000000000LL +
+	  (now.tv_nsec - rx.tv_nsec);
+	if (age_ns >= 0) {
+	  _rx_ticks = ticks - (unsigned long) (((uint64_t) age_ns) /
+	    (1000000000ULL / PRECISE_SNTP_TICKS_PER_SECOND));
+	  _rx_valid = true;
+	}
+      }
+    }
+#endif
+    last_received() = this;
+    return (int) _size;
+  }
+
+  int read(unsigned char* buffer, size_t len) {
+    if (len > _size - _position) {
+      len = _size - _position;
+    }
+    memcpy(buffer, _buffer + _position, len);
+    _position += len;
+    return (int) len;
+  }
+
+  int read(char* buffer, size_t len) {
+    return read((unsigned char*) buffer, len);
+  }
+
+  IPAddress remoteIP() {
+    return sockaddr2ip(&_remote);
+  }
+
+  uint16_t remotePort() {
+    return ntohs(_remote.sin_port);
+  }
+
+  /*
+    Gives the ticks (PRECISE_SNTP_TICKS()) the kernel received the last
+    packet of parsePacket().
+
+    returns false if the kernel gave no timestamp
+  */
+  bool get_receive_ticks(unsigned long *ticks) {
+    if (!_rx_valid) {
+      return false;
+    }
+    *ticks = _rx_ticks;
+    return true;
+  }
+
+  /*
+    Receive timestamp hook for precise_sntp::set_receive_timestamp_hook():
+    gives the receive ticks of the last packet of parsePacket() of any
+    posix_udp instance.
+  */
+  static bool receive_timestamp_hook(unsigned long *ticks) {
+    return last_received() && last_received()->get_receive_ticks(ticks);
+  }
+
+ private:
+  int _socket = -1;
+  uint16_t _port = 0;
+  uint16_t _destination_port = 0;
+  struct sockaddr_in _destination;
+  uint8_t _packet[POSIX_UDP_BUFFER_SIZE]; // packet to send
+  size_t _packet_size = 0;
+  struct sockaddr_in _remote;
+  uint8_t _buffer[POSIX_UDP_BUFFER_SIZE]; // received packet
+  size_t _size = 0;
+  size_t _position = 0;
+  unsigned long _rx_ticks = 0;
+  bool _rx_valid = false;
+
+  static IPAddress sockaddr2ip(const struct sockaddr_in *address) {
+    uint8_t b[4];
+    memcpy(b, &(address->sin_addr.s_addr), 4);
+    return IPAddress(b[0], b[1], b[2], b[3]);
+  }
+
+  static posix_udp*& last_received() {
+    static posix_udp *udp = NULL;
+    return udp;
+  }
+};
@@ -0,0 +1,52 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Example of precise_sntp on Linux with the POSIX UDP backend
+  (posix_udp.h): starts with an iburst and polls an ntp server with the
+  receive timestamps of the kernel. After each poll the time, its error
+  bound and the round-trip delay are printed.
+
+  Compile in the root directory of the library:
+
+    g++ -O2 -DPRECISE_SNTP_USE_MICROS -I extras/posix -I src \
+      -o sntp_client extras/posix/sntp_client.cpp src/precise_sntp*.cpp
+
+  Usage:
+
+    ./sntp_client [server [port]]
+
+  The default server is pool.ntp.org on port 123.
+*/
+
+#include <Arduino.h>
+#include <posix_udp.h>
+#include <precise_sntp.h>
+
+int main(int argc, char *argv[]) {
+  const char *server = (argc > 1) ? argv[1] : "pool.ntp.org";
+  posix_udp udp;
+  if (argc > 2) {
+    udp.set_destination_port((uint16_t) atoi(argv[2]));
+  }
+  precise_sntp sntp(udp, server);
+  sntp.set_receive_timestamp_hook(posix_udp::receive_timestamp_hook);
+  sntp.begin_iburst(); // fills the clock filter in about 2 seconds
+  while (true) {
+    const uint8_t ret = sntp.update_async(true);
+    if (ret == 0) {
+      const timestamp_with_error_format t = sntp.tget_epoch_with_error();
+      printf("%lu.%06lu error bound %.3f ms delay %.3f ms\n",
+	     (unsigned long) t.seconds,
+	     (unsigned long) ((((uint64_t) t.fraction) * 1000000ULL) >> 32),
+	     ((double) t.error) / 4294967.296,
+	     ((double) sntp.get_delay()) / 4294967.296);
+      fflush(stdout);
+    } else if ((ret != 1) && (ret != PRECISE_SNTP_POLL_PENDING)) {
+      printf("error %u\n", (unsigned int) ret);
+      fflush(stdout);
+    }
+    delayMicroseconds(100);
+  }
+  return 0;
+}
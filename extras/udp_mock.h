@@ -19,4 +19,6 @@ class UDP {
   virtual int parsePacket() = 0;
   virtual int read(unsigned char* buffer, size_t len) = 0;
   virtual int read(char* buffer, size_t len) = 0;
+  virtual IPAddress remoteIP() = 0;
+  virtual uint16_t remotePort() = 0;
 };
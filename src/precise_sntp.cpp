@@ -1,6 +1,6 @@
 /*
   Author: Daniel Mohr
-  Date: 2023-08-02
+  Date: 2026-10-17
 
   For more information look at the README.md.
 
@@ -8,69 +8,404 @@
 */
 
 #include <precise_sntp.h>
+#ifdef PRECISE_SNTP_UDP_INCLUDE
+#include PRECISE_SNTP_UDP_INCLUDE
+#endif
 
-#include <precise_sntp_htonl_htons.h>
+#include <precise_sntp_clock_history.h>
+#include <precise_sntp_convert_ticks.h>
+#include <precise_sntp_crc16.h>
+#include <precise_sntp_isqrt.h>
+#include <precise_sntp_latch.h>
 #include <precise_sntp_ntp_local_clock_union2uint64.h>
+#include <precise_sntp_ntp_packet.h>
+#include <precise_sntp_ntp_packet_view.h>
 #include <precise_sntp_ntp_timestamp_format2doubleepoch.h>
+#include <precise_sntp_ntp_timestamp_format2uint64.h>
+#include <precise_sntp_storage.h>
+#include <precise_sntp_ticks2duration.h>
+#include <precise_sntp_xorshift32.h>
 
-#define NTP_PACKET_SIZE 48
+#ifdef PRECISE_SNTP_UDP_INCLUDE
+// calls the method of the driver directly (no virtual dispatch)
+#define NTP_UDP(method) _udp->PRECISE_SNTP_UDP_TYPE::method
+#else
+#define NTP_UDP(method) _udp->method
+#endif
 #define NTP_MIN_POLL_EXPONENT 4
 #define NTP_MAX_POLL_EXPONENT 17
+#define NTP_MAXDISP (((uint64_t) 16) << 32) // maximum dispersion (16 s)
+#define NTP_PHI_SHIFT 16 // frequency tolerance 2^-16 (about 15 ppm)
+#ifdef PRECISE_SNTP_USE_MICROS
+#define NTP_LOCAL_PRECISION_EXPONENT -20 // about 1 us (micros())
+#else
+#define NTP_LOCAL_PRECISION_EXPONENT -10 // about 1 ms (millis())
+#endif
+#define NTP_DURATION_PER_TICK_INT \
+  PRECISE_SNTP_DURATION_PER_TICK_INT(PRECISE_SNTP_TICKS_PER_SECOND)
+#define NTP_DURATION_PER_TICK_FRAC \
+  PRECISE_SNTP_DURATION_PER_TICK_FRAC(PRECISE_SNTP_TICKS_PER_SECOND)
+#define NTP_LOCAL_PRECISION \
+  (((uint64_t) 1) << (32 + NTP_LOCAL_PRECISION_EXPONENT))
+#define NTP_MAXFREQ 2147484 // maximum frequency correction 500 ppm (* 2^32)
+#define NTP_FLL_GAIN_SHIFT 1 // frequency-lock loop gain 1/2
+#define NTP_MINCLOCK 3 // minimum number of survivors of the cluster algorithm
+#define NTP_RESOLVE_FAILURES 3 // resolve the name again after 3 failures
+#define NTP_STEP_THRESHOLD (((uint64_t) 1) << 32) // step the clock above 1 s
+#define NTP_PGATE 4 // poll-adjust gate (offset compared to jitter)
+#define NTP_POLL_LIMIT 30 // poll-adjust threshold of the hysteresis counter
+#define NTP_AVG_SHIFT 2 // averaging constant 1/4 of the clock jitter
+#define NTP_MILLIS2DURATION(x) (((uint64_t) (x)) * 4294967ULL) // 2^32/1000
+
+static void clock_filter_clear(struct precise_sntp_clock_filter *f) {
+  memset(f, 0, sizeof(struct precise_sntp_clock_filter));
+}
+
+static void clock_filter_add(struct precise_sntp_clock_filter *f,
+			     int64_t offset, uint64_t delay,
+			     uint64_t dispersion, unsigned long time) {
+  struct precise_sntp_filter_sample *sample = &(f->samples[f->next]);
+  sample->offset = offset;
+  sample->delay = delay;
+  sample->dispersion = dispersion;
+  sample->time = time;
+  f->next = (f->next + 1) % PRECISE_SNTP_FILTER_STAGES;
+  if (f->count < PRECISE_SNTP_FILTER_STAGES) {
+    f->count++;
+  }
+}
+
+/*
+  returns a + b and a - b limited to the range of int64_t, the offsets of
+  bogus answers can be close to +-2^63
+*/
+static inline int64_t saturating_add(int64_t a, int64_t b) {
+  if ((b > 0) && (a > INT64_MAX - b)) {
+    return INT64_MAX;
+  }
+  if ((b < 0) && (a < INT64_MIN - b)) {
+    return INT64_MIN;
+  }
+  return a + b;
+}
+
+static inline int64_t saturating_sub(int64_t a, int64_t b) {
+  if ((b < 0) && (a > INT64_MAX + b)) {
+    return INT64_MAX;
+  }
+  if ((b > 0) && (a < INT64_MIN + b)) {
+    return INT64_MIN;
+  }
+  return a - b;
+}
+
+/*
+  difference of two offsets in units of 2^-16 seconds, limited to avoid
+  an overflow when squared and summed up
+*/
+static inline int64_t offset_difference(int64_t a, int64_t b) {
+  int64_t diff = saturating_sub(a, b) >> 16;
+  if (diff > (((int64_t) 1) << 24)) {
+    diff = ((int64_t) 1) << 24;
+  } else if (diff < -(((int64_t) 1) << 24)) {
+    diff = -(((int64_t) 1) << 24);
+  }
+  return diff;
+}
+
+/*
+  Selects the sample with the lowest delay and calculates the filter
+  dispersion and jitter (RFC 5905 section 10). The samples are sorted by
+  delay plus dispersion, which grows with the age of a sample.
+
+  returns true, if the selected sample is newer than the last used one
+*/
+static bool clock_filter_select(struct precise_sntp_clock_filter *f,
+				unsigned long now) {
+  if (f->count == 0) {
+    return false;
+  }
+  uint8_t order[PRECISE_SNTP_FILTER_STAGES];
+  uint64_t dispersion[PRECISE_SNTP_FILTER_STAGES];
+  uint64_t distance[PRECISE_SNTP_FILTER_STAGES];
+  for (uint8_t i = 0; i < f->count; i++) {
+    // newest sample first, so on equal distance the newer one is selected
+    const uint8_t index = (f->next + PRECISE_SNTP_FILTER_STAGES - 1 - i) %
+      PRECISE_SNTP_FILTER_STAGES;
+    // the dispersion grows with the age of the sample
+    dispersion[index] = f->samples[index].dispersion +
+      (NTP_MILLIS2DURATION(now - f->samples[index].time) >> NTP_PHI_SHIFT);
+    // sort by delay, the aged dispersion lets old samples lose
+    distance[index] = f->samples[index].delay + dispersion[index];
+    uint8_t j = i;
+    while ((j > 0) && (distance[order[j - 1]] > distance[index])) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = index;
+  }
+  const struct precise_sntp_filter_sample *selected = &(f->samples[order[0]]);
+  f->offset = selected->offset;
+  f->delay = selected->delay;
+  // filter dispersion: sum of the dispersions sorted by delay and weighted
+  // by 2^-(i+1), empty stages count as NTP_MAXDISP
+  f->dispersion = 0;
+  for (uint8_t i = 0; i < PRECISE_SNTP_FILTER_STAGES; i++) {
+    if (i < f->count) {
+      f->dispersion += dispersion[order[i]] >> (i + 1);
+    } else {
+      f->dispersion += NTP_MAXDISP >> (i + 1);
+    }
+  }
+  // filter jitter: root mean square of the offset differences,
+  // calculated in units of 2^-16 seconds to avoid an overflow
+  uint64_t sum = 0;
+  for (uint8_t i = 1; i < f->count; i++) {
+    const int64_t diff =
+      offset_difference(f->samples[order[i]].offset, selected->offset);
+    sum += (uint64_t) (diff * diff);
+  }
+  f->jitter = 0;
+  if (f->count > 1) {
+    f->jitter = precise_sntp_isqrt64(sum / (f->count - 1)) << 16;
+  }
+  if (f->jitter < NTP_LOCAL_PRECISION) {
+    f->jitter = NTP_LOCAL_PRECISION;
+  }
+  // only use samples newer than the last used one
+  if (f->used && ((long) (selected->time - f->last_used) <= 0)) {
+    return false;
+  }
+  f->used = true;
+  f->last_used = selected->time;
+  return true;
+}
+
+/*
+  The offsets in the filter are relative to the local clock.
+  If the local clock is corrected, they have to be corrected as well.
+*/
+static void clock_filter_correct(struct precise_sntp_clock_filter *f,
+				 int64_t correction) {
+  for (uint8_t i = 0; i < f->count; i++) {
+    f->samples[i].offset -= correction;
+  }
+  f->offset -= correction;
+}
+
+static inline uint64_t precision2duration(int8_t precision) {
+  if (precision <= -32) {
+    return 1;
+  } else if (precision >= 0) {
+    return ((uint64_t) 1) << 32;
+  }
+  return ((uint64_t) 1) << (32 + precision);
+}
+
+/*
+  root distance of an association (RFC 5905 section 11.2.1): half the delay
+  plus the dispersion and jitter of its filter, aged since the last sample
+*/
+static uint64_t root_distance(const struct precise_sntp_association *a,
+			      unsigned long now) {
+  const struct precise_sntp_clock_filter *f = &(a->filter);
+  const uint8_t newest = (f->next + PRECISE_SNTP_FILTER_STAGES - 1) %
+    PRECISE_SNTP_FILTER_STAGES;
+  const unsigned long last = f->samples[newest].time;
+  // root delay and root dispersion of the server (ntp short format)
+  return (f->delay >> 1) + (((uint64_t) a->rootdelay) << 15) +
+    (((uint64_t) a->rootdisp) << 16) + f->dispersion + f->jitter +
+    (NTP_MILLIS2DURATION(now - last) >> NTP_PHI_SHIFT);
+}
 
-struct ntp_short_format_struct { // 4 bytes
-  uint16_t seconds;
-  uint16_t fraction;
-};
-struct ntp_packet_struct { // 48 bytes, all in network byte order
-  byte leap_version_mode; // leap indicator, version number, mode
-  byte stratum;
-  byte poll; // poll exponent
-  byte precision; // precision exponent
-  struct ntp_short_format_struct rootdelay; // root delay
-  struct ntp_short_format_struct rootdisp; // root dispersion
-  byte refid[4]; // reference ID
-  struct ntp_timestamp_format_struct reftime; // reference timestamp
-  struct ntp_timestamp_format_struct org; // origin timestamp
-  struct ntp_timestamp_format_struct rec; // receive timestamp
-  struct ntp_timestamp_format_struct xmt; // transmit timestamp
-};
-union ntp_packet_union {
-  byte as_bytes[NTP_PACKET_SIZE];
-  struct ntp_packet_struct as_ntp_packet;
-};
-
-static inline void ntp_short_format_ntoh(ntp_short_format_struct *t) {
-  t->seconds = ntohs(t->seconds);
-  t->fraction = ntohs(t->fraction);
-}
-
-static inline void ntp_timestamp_format_ntoh(ntp_timestamp_format_struct *t) {
-  t->seconds = ntohl(t->seconds);
-  t->fraction = ntohl(t->fraction);
-}
-
-static inline void ntp_timestamp_format_hton(ntp_timestamp_format_struct *t) {
-  t->seconds = htonl(t->seconds);
-  t->fraction = htonl(t->fraction);
-}
-
-precise_sntp::precise_sntp(UDP &udp) {
+/*
+  returns the local clock at the extended ticks for the clock state c,
+  with pending the correction not slewed yet is included
+*/
+static uint64_t clock_state2clock(const struct precise_sntp_clock_state *c,
+				  uint64_t ticks, bool pending=false) {
+  const uint64_t elapsed =
+    precise_sntp_ticks2duration(ticks - c->last_clock_update,
+				NTP_DURATION_PER_TICK_INT, NTP_DURATION_PER_TICK_FRAC);
+  // frequency correction in units of 2^-32 seconds:
+  // elapsed * frequency / 2^32
+  const int64_t correction =
+    (((int64_t) (elapsed >> 16)) * c->frequency) / (((int64_t) 1) << 16);
+  // the slew is applied with at most slew_rate: elapsed * slew_rate / 2^32
+  int64_t slewed = c->slew;
+  if ((!pending) && (slewed != 0)) {
+    const int64_t max_slew =
+      (int64_t) (((elapsed >> 16) * c->slew_rate) >> 16);
+    if (slewed > max_slew) {
+      slewed = max_slew;
+    } else if (slewed < -max_slew) {
+      slewed = -max_slew;
+    }
+  }
+  return (int64_t) _ntp_local_clock_union2uint64(c->clock) +
+    elapsed + correction + slewed;
+}
+
+/*
+  returns the local clock at the continuous ticks for the segment s of the
+  clock history, ticks before the segment are extrapolated
+*/
+static uint64_t clock_segment2clock(const struct precise_sntp_clock_segment *s,
+				    uint64_t ticks) {
+  struct precise_sntp_convert_ticks_parameter p;
+  const bool after = (ticks >= s->ticks);
+  const uint64_t elapsed =
+    precise_sntp_ticks2duration(after ? ticks - s->ticks : s->ticks - ticks,
+				NTP_DURATION_PER_TICK_INT, NTP_DURATION_PER_TICK_FRAC);
+  p.now_ticks = 0;
+  p.elapsed = after ? (int64_t) elapsed : -((int64_t) elapsed);
+  p.clock = s->clock;
+  p.frequency = s->frequency;
+  p.slew_rate = s->slew_rate;
+  p.slew = s->slew;
+  p.per_tick_int = NTP_DURATION_PER_TICK_INT;
+  p.per_tick_frac = NTP_DURATION_PER_TICK_FRAC;
+  return precise_sntp_convert_tick(&p, 0);
+}
+
+precise_sntp::precise_sntp(PRECISE_SNTP_UDP_TYPE &udp) {
   _udp = &udp;
-  _ntp_server_name = "pool.ntp.org";
-  memset(_ntp_local_clock.as_bytes, 0, 8);
+  memset(&_clock, 0, sizeof(struct precise_sntp_clock_state));
+  publish_clock();
+  memset(&_iburst, 0, sizeof(struct precise_sntp_iburst_status));
+  init_association(IPAddress(), "pool.ntp.org");
 }
 
-precise_sntp::precise_sntp(UDP &udp, IPAddress ntp_server_ip) {
+precise_sntp::precise_sntp(PRECISE_SNTP_UDP_TYPE &udp,
+			   IPAddress ntp_server_ip) {
   _udp = &udp;
-  _ntp_server_ip = ntp_server_ip;
-  _ntp_server_name = NULL;
-  memset(_ntp_local_clock.as_bytes, 0, 8);
+  memset(&_clock, 0, sizeof(struct precise_sntp_clock_state));
+  publish_clock();
+  memset(&_iburst, 0, sizeof(struct precise_sntp_iburst_status));
+  init_association(ntp_server_ip, NULL);
 }
 
-precise_sntp::precise_sntp(UDP &udp, const char* ntp_server_name) {
+precise_sntp::precise_sntp(PRECISE_SNTP_UDP_TYPE &udp,
+			   const char* ntp_server_name) {
   _udp = &udp;
-  _ntp_server_name = ntp_server_name;
-  memset(_ntp_local_clock.as_bytes, 0, 8);
+  memset(&_clock, 0, sizeof(struct precise_sntp_clock_state));
+  publish_clock();
+  memset(&_iburst, 0, sizeof(struct precise_sntp_iburst_status));
+  init_association(IPAddress(), ntp_server_name);
+}
+
+bool precise_sntp::init_association(IPAddress ntp_server_ip,
+				    const char* ntp_server_name) {
+  if (_number_of_associations >= PRECISE_SNTP_MAX_SERVERS) {
+    return false;
+  }
+  struct precise_sntp_association *a =
+    &(_associations[_number_of_associations]);
+  a->ip = ntp_server_ip;
+  a->name = ntp_server_name;
+  clock_filter_clear(&(a->filter));
+  a->reach = 0;
+  a->result = 0;
+  a->poll = 0;
+  a->new_sample = false;
+  a->resolved = false;
+  a->resolved_time = 0;
+  a->failures = 0;
+  a->denied = false;
+  a->stratum = 0;
+  a->leap = 0;
+  a->rootdelay = 0;
+  a->rootdisp = 0;
+  a->broadcast_delay = 0;
+  _number_of_associations++;
+  return true;
+}
+
+bool precise_sntp::add_server(IPAddress ntp_server_ip) {
+  return init_association(ntp_server_ip, NULL);
+}
+
+bool precise_sntp::add_server(const char* ntp_server_name) {
+  return init_association(IPAddress(), ntp_server_name);
+}
+
+void precise_sntp::set_resolver(int (*resolver)(const char* name,
+						IPAddress &ip)) {
+  _resolver = resolver;
+}
+
+void precise_sntp::set_resolve_lifetime(unsigned long seconds) {
+  if (seconds > 4294967UL) {
+    seconds = 4294967UL;
+  }
+  _resolve_lifetime = 1000UL * seconds;
+}
+
+/*
+  Resolves the name of the association, if there is no cached address,
+  the cached one is too old or the server did not answer several times.
+*/
+void precise_sntp::resolve_association(
+  struct precise_sntp_association *association) {
+  if (association->resolved &&
+      (millis() - association->resolved_time < _resolve_lifetime) &&
+      (association->failures < NTP_RESOLVE_FAILURES)) {
+    return;
+  }
+  IPAddress ip;
+  bool resolved = false;
+  for (uint8_t attempt = 0; attempt < PRECISE_SNTP_MAX_SERVERS; attempt++) {
+    if (_resolver(association->name, ip) != 1) {
+      break;
+    }
+    resolved = true;
+    // prefer an address not used by another server with the same name
+    bool used = (association->resolved && (association->ip == ip) &&
+		 (association->failures >= NTP_RESOLVE_FAILURES));
+    for (uint8_t i = 0; i < _number_of_associations; i++) {
+      const struct precise_sntp_association *a = &(_associations[i]);
+      if ((a != association) && a->resolved && (a->ip == ip) &&
+	  (strcmp(a->name, association->name) == 0)) {
+	used = true;
+      }
+    }
+    if (!used) {
+      break;
+    }
+  }
+#ifdef PRECISE_SNTP_DEBUG
+  Serial.print("resolved ");
+  Serial.print(association->name);
+  Serial.print(": ");
+  Serial.println(resolved);
+#endif
+  if (resolved) {
+    association->ip = ip;
+    association->resolved = true;
+    association->failures = 0;
+  }
+  // if the resolution failed, the cached address (if any) is used further
+  association->resolved_time = millis();
+}
+
+uint8_t precise_sntp::get_number_of_servers() {
+  return _number_of_associations;
+}
+
+uint8_t precise_sntp::get_number_of_survivors() {
+  return _number_of_survivors;
+}
+
+uint8_t precise_sntp::get_system_peer() {
+  return _system_peer;
+}
+
+void precise_sntp::clear_filters() {
+  for (uint8_t i = 0; i < _number_of_associations; i++) {
+    clock_filter_clear(&(_associations[i].filter));
+    _associations[i].new_sample = false;
+  }
+  _correction_used = false;
 }
 
 void precise_sntp::set_poll_exponent_range(uint8_t min_poll, uint8_t max_poll) {
@@ -86,45 +421,74 @@ void precise_sntp::set_poll_exponent_range(uint8_t min_poll, uint8_t max_poll) {
   }
 }
 
+/*
+  returns poll limited to the range of set_poll_exponent_range()
+*/
+uint8_t precise_sntp::clamp_poll_exponent(uint8_t poll) {
+  if (poll < _min_poll_exponent) {
+    return _min_poll_exponent;
+  }
+  if (poll > _max_poll_exponent) {
+    return _max_poll_exponent;
+  }
+  return poll;
+}
+
+uint8_t precise_sntp::get_poll_exponent() {
+  return _poll_exponent;
+}
+
 void precise_sntp::check_millis_overflow() {
-  static uint32_t last_check = 0;
-  const uint32_t mtime = millis();
-  if (mtime < last_check) {
-    _millis_overflow_count++;
+  const unsigned long ticks = PRECISE_SNTP_TICKS();
+  const bool overflow = (ticks < _clock.last_overflow_check);
+  if (overflow) {
+    _clock.ticks_overflow_count++;
+  }
+  _clock.last_overflow_check = ticks;
+  if (overflow) {
+    publish_clock();
   }
-  last_check = mtime;
 }
 
 uint8_t precise_sntp::update() {
-  check_millis_overflow();
-  if (_is_synced && (_next_update_period > millis() - _last_update)) {
-    return 1;
+  uint8_t ret;
+  while ((ret = update_async()) == PRECISE_SNTP_POLL_PENDING) {
+    // Wait until the poll is finished.
   }
-  return force_update();
+  return ret;
 }
 
 uint8_t precise_sntp::update_adapt_poll_period() {
-  const bool was_synchronized = (_is_synced) &&
-    (_last_update + 2 * 1000 * (1 << _poll_exponent) > millis());
-  const uint8_t old_poll_exponent = _poll_exponent;
-  const uint8_t ret = update();
-  if (ret == 1) {
-    return ret;
+  uint8_t ret;
+  while ((ret = update_async(true)) == PRECISE_SNTP_POLL_PENDING) {
+    // Wait until the poll is finished.
   }
-  if (was_synchronized && (ret == 0)) {
-    if (old_poll_exponent < _max_poll_exponent) {
-      _poll_exponent = old_poll_exponent + 1; // adapt poll period
-      _next_update_period = 1000 * (1 << _poll_exponent);
+  return ret;
+}
+
+uint8_t precise_sntp::update_async(bool adapt_poll_period) {
+  if (_broadcast && (_poll_state == PRECISE_SNTP_POLL_IDLE)) {
+    return receive_broadcast();
+  }
+  if (_poll_state == PRECISE_SNTP_POLL_IDLE) {
+    check_millis_overflow();
+    if (_start_delay_pending) {
+      // spread the first polls of many devices started at the same time
+      _start_delay_pending = false;
+      _retry_start = millis();
+      _retry_delay = random_delay(_max_start_delay);
     }
-  } else if (ret > 1) {
-    if (_min_poll_exponent < old_poll_exponent) {
-      _poll_exponent = old_poll_exponent - 1; // adapt poll period
-      if (was_synchronized) {
-	_next_update_period = 1000 * (1 << _poll_exponent);
-      }
+    if ((_is_synced && (_next_update_period > millis() - _last_update)) ||
+	(millis() - _retry_start < _retry_delay)) {
+#ifdef PRECISE_SNTP_STATISTICS
+      _statistics.results[1]++;
+#endif
+      return 1;
     }
+    begin_poll();
+    _adapt_poll_period = adapt_poll_period;
   }
-  return ret;
+  return service();
 }
 
 uint64_t precise_sntp::force_update_iburst(uint8_t n, uint16_t d) {
@@ -134,197 +498,1041 @@ uint64_t precise_sntp::force_update_iburst(uint8_t n, uint16_t d) {
   uint64_t ret = force_update(true);
   for (uint8_t i = 1; i < n; i++) {
     delay(d);
-    ret += force_update() << (i * 4);
+    ret += ((uint64_t) force_update()) << (i * 4);
   }
   return ret;
 }
 
 uint8_t precise_sntp::force_update(bool use_transmit_timestamp) {
-  _is_synced = false;
+  if (!begin_poll(use_transmit_timestamp)) {
+    return 13;
+  }
+  return wait_for_poll();
+}
+
+bool precise_sntp::begin_poll(bool use_transmit_timestamp) {
+  if (_poll_state != PRECISE_SNTP_POLL_IDLE) {
+    return false;
+  }
+  _use_transmit_timestamp = use_transmit_timestamp;
+  _adapt_poll_period = false;
+  _was_synchronized = _clock_set &&
+    (_last_update + 2 * 1000 * (1 << _poll_exponent) > millis());
+  // the range could have been changed by set_poll_exponent_range()
+  _old_poll_exponent = clamp_poll_exponent(_poll_exponent);
+  _association = 0;
+  for (uint8_t i = 0; i < _number_of_associations; i++) {
+    _associations[i].new_sample = false;
+  }
+  _round_success = false;
+  _round_stepped = false;
+  _round_result = 0;
+  _round_corrected = false;
+  _round_rate_limited = false;
+  _poll_state = PRECISE_SNTP_POLL_SEND;
+#ifdef PRECISE_SNTP_STATISTICS
+  _statistics_poll_start = micros();
+  _statistics_service_time = 0;
+#endif
+  return true;
+}
+
+uint8_t precise_sntp::service() {
+#ifdef PRECISE_SNTP_STATISTICS
+  const unsigned long start = micros();
+  const uint8_t ret = service_step();
+  _statistics_service_time += micros() - start;
+  if (ret != PRECISE_SNTP_POLL_PENDING) {
+    _statistics.service_time = _statistics_service_time;
+    if (_statistics_service_time > _statistics.service_time_max) {
+      _statistics.service_time_max = _statistics_service_time;
+    }
+  }
+  return ret;
+#else
+  return service_step();
+#endif
+}
+
+/*
+  One step of the poll state machine, see service().
+*/
+uint8_t precise_sntp::service_step() {
+  switch (_poll_state) {
+  case PRECISE_SNTP_POLL_SEND:
+    return send_request();
+  case PRECISE_SNTP_POLL_AWAIT_REPLY:
+    return await_reply();
+  case PRECISE_SNTP_POLL_VALIDATE:
+    return validate_reply();
+  case PRECISE_SNTP_POLL_FILTER:
+    return filter_reply();
+  case PRECISE_SNTP_POLL_APPLY:
+    return apply_samples();
+  case PRECISE_SNTP_POLL_IBURST:
+    return iburst_step();
+  default:
+    return 1;
+  }
+}
+
+precise_sntp_poll_state precise_sntp::get_poll_state() {
+  return _poll_state;
+}
+
+void precise_sntp::set_poll_callback(void (*callback)(uint8_t result)) {
+  _poll_callback = callback;
+}
+
+uint8_t precise_sntp::wait_for_poll() {
+  uint8_t ret;
+  while ((ret = service()) == PRECISE_SNTP_POLL_PENDING) {
+    // Each step returns quickly, waiting for the server is done here.
+  }
+  return ret;
+}
+
+uint8_t precise_sntp::finish_poll(uint8_t result) {
+  _poll_state = PRECISE_SNTP_POLL_IDLE;
+  if (_iburst.running) {
+    _iburst.running = false;
+    _iburst.result = result;
+  }
+  _is_synced = (result == 0);
+  if ((3 <= result) && (result <= 12)) {
+    // exponential backoff with jitter: wait 1 s, 2 s, 4 s, ... up to the
+    // minimal poll period (times a random factor between 0.5 and 1)
+    if (_backoff < 255) {
+      _backoff++;
+    }
+    uint8_t exponent = _backoff - 1;
+    if ((result == 8) || (result >= 10) || (exponent > _min_poll_exponent)) {
+      // handle stratum == 0 and the kiss codes as KoD
+      exponent = _min_poll_exponent;
+    }
+    const unsigned long period = 1000UL << exponent;
+    _retry_start = millis();
+    _retry_delay = period / 2 + random_delay(period / 2);
+  } else if (result == 0) {
+    _backoff = 0;
+    _retry_delay = 0;
+  }
+  if (_adapt_poll_period) {
+    if (_was_synchronized && (result == 0)) {
+      if (_round_corrected) {
+	// adapt poll period
+	const uint64_t jitter = (_clock_jitter > NTP_LOCAL_PRECISION) ?
+	  _clock_jitter : NTP_LOCAL_PRECISION;
+	adjust_poll_exponent(((uint64_t) abs(_round_offset)) <
+			     NTP_PGATE * jitter);
+      } else {
+	_poll_exponent = _old_poll_exponent;
+      }
+      _next_update_period = 1000 * (1 << _poll_exponent);
+    } else if (_warm_start && (result == 0)) {
+      // continue with the poll exponent of the imported state
+      _poll_exponent = _old_poll_exponent;
+      _next_update_period = 1000 * (1 << _poll_exponent);
+    } else if (result > 1) {
+      // like RFC 5905 a lost answer does not change the poll period,
+      // the poll is repeated soon (see update_async())
+      _poll_exponent = _old_poll_exponent;
+      if (_was_synchronized) {
+	_next_update_period = 1000 * (1 << _poll_exponent);
+      }
+    }
+  }
+  if (result == 0) {
+    _warm_start = false;
+  }
+  if ((result == 0) && (_poll_jitter > 0)) {
+    // shorten the poll period randomly
+    _next_update_period -=
+      random_delay(_next_update_period / 100 * _poll_jitter);
+  }
+#ifdef PRECISE_SNTP_STATISTICS
+  if (result < 13) {
+    _statistics.results[result]++;
+  }
+  _statistics.poll_duration = micros() - _statistics_poll_start;
+  if (_statistics.poll_duration > _statistics.poll_duration_max) {
+    _statistics.poll_duration_max = _statistics.poll_duration;
+  }
+#endif
+  if (_poll_callback) {
+    _poll_callback(result);
+  }
+  return result;
+}
+
+void precise_sntp::set_random_seed(uint32_t seed) {
+  if (seed != 0) {
+    _random_state = seed;
+  }
+}
+
+void precise_sntp::set_start_delay(unsigned long max_delay) {
+  // also avoids an overflow of max_delay + 1 in random_delay()
+  _max_start_delay = (max_delay < PRECISE_SNTP_MAX_START_DELAY) ?
+    max_delay : PRECISE_SNTP_MAX_START_DELAY;
+}
+
+void precise_sntp::set_poll_jitter(uint8_t percent) {
+  _poll_jitter = (percent <= 50) ? percent : 50;
+}
+
+/*
+  returns the next pseudo random number, the state is seeded at first use
+*/
+uint32_t precise_sntp::random32() {
+  if (_random_state == 0) {
+    _random_state = ((uint32_t) PRECISE_SNTP_TICKS()) ^
+      _clock.clock.as_timestamp.fraction ^ 0x9E3779B9UL;
+    if (_random_state == 0) {
+      _random_state = 1;
+    }
+  }
+  return precise_sntp_xorshift32(&_random_state);
+}
+
+/*
+  returns a random delay from 0 to max_delay
+*/
+unsigned long precise_sntp::random_delay(unsigned long max_delay) {
+  if (max_delay == 0) {
+    return 0;
+  }
+  return random32() % (max_delay + 1);
+}
+
+/*
+  Clock jitter of RFC 5905 (appendix A.5.5.1): root mean square of the
+  differences of successive corrections, exponentially averaged. Unlike
+  the filter jitter it does not grow with a steady frequency error, whose
+  corrections are all alike.
+*/
+void precise_sntp::update_clock_jitter(int64_t offset) {
+  // in units of 2^-16 seconds to avoid an overflow
+  const int64_t diff = offset_difference(offset, _last_offset);
+  const int64_t jitter = (int64_t) (_clock_jitter >> 16);
+  const int64_t square = jitter * jitter;
+  _clock_jitter = precise_sntp_isqrt64(
+    (uint64_t) (square + ((diff * diff - square) >> NTP_AVG_SHIFT))) << 16;
+  _last_offset = offset;
+}
+
+/*
+  Poll-adjust of RFC 5905 (appendix A.5.5.1): If the offset of this poll
+  is small compared to the clock jitter (good), the counter is increased
+  by the poll exponent, otherwise it is decreased by twice the poll
+  exponent. The poll exponent is only changed if the counter exceeds
+  +-NTP_POLL_LIMIT. So a clock dominated by jitter is polled seldom (long
+  poll periods average the jitter) and a wandering one often.
+*/
+void precise_sntp::adjust_poll_exponent(bool good) {
+  uint8_t poll = _old_poll_exponent;
+  int16_t counter = _poll_counter;
+  if (good) {
+    counter += poll;
+    if (counter > NTP_POLL_LIMIT) {
+      counter = NTP_POLL_LIMIT;
+      if (poll < _max_poll_exponent) {
+	counter = 0;
+	poll++;
+      }
+    }
+  } else {
+    counter -= 2 * poll;
+    if (counter < -NTP_POLL_LIMIT) {
+      counter = -NTP_POLL_LIMIT;
+      if (poll > _min_poll_exponent) {
+	counter = 0;
+	poll--;
+      }
+    }
+  }
+  _poll_counter = (int8_t) counter;
+  _poll_exponent = poll;
+}
+
+/*
+  Stores the result of a request to the server _association.
+*/
+void precise_sntp::store_result(uint8_t result) {
+  struct precise_sntp_association *server = &(_associations[_association]);
+  server->result = result;
+  if ((result == 3) || (result == 6)) {
+    if (server->failures < 255) {
+      server->failures++;
+    }
+  } else if (result == 0) {
+    server->failures = 0;
+  } else if (result == 10) {
+    // kiss code RATE: poll less often, but only one step each poll
+    if ((!_round_rate_limited) && (_min_poll_exponent < _max_poll_exponent)) {
+      _min_poll_exponent++;
+    }
+    if (_poll_exponent < _min_poll_exponent) {
+      _poll_exponent = _min_poll_exponent;
+    }
+    _round_rate_limited = true;
+  } else if (result == 11) {
+    // kiss code DENY or RSTR: do not ask this server again
+    server->denied = true;
+  }
+  if (result == 0) {
+    _round_success = true;
+  } else {
+    _round_result = result;
+  }
+}
+
+/*
+  Stores the result of the polled server and continues with the next one.
+  After the last server the answers are applied, if at least one was valid.
+*/
+uint8_t precise_sntp::next_association(uint8_t result) {
+  store_result(result);
+  _association++;
+  if (_association < _number_of_associations) {
+    _poll_state = PRECISE_SNTP_POLL_SEND;
+    return PRECISE_SNTP_POLL_PENDING;
+  }
+  if (!_round_success) {
+    return finish_poll(_round_result);
+  }
+  _poll_state = PRECISE_SNTP_POLL_APPLY;
+  return PRECISE_SNTP_POLL_PENDING;
+}
+
+bool precise_sntp::begin_iburst(uint8_t n, uint16_t d) {
+  if (!begin_poll()) {
+    return false;
+  }
+  memset(&_iburst, 0, sizeof(struct precise_sntp_iburst_status));
+  memset(_iburst_slots, 0, sizeof(_iburst_slots));
+  _iburst.running = true;
+  _iburst.requests = (n > 0) ? n : 1;
+  _iburst.result = PRECISE_SNTP_POLL_PENDING;
+  _iburst_interval = d;
+  _poll_state = PRECISE_SNTP_POLL_IBURST;
+  return true;
+}
+
+struct precise_sntp_iburst_status precise_sntp::get_iburst_status() {
+  return _iburst;
+}
+
+/*
+  One step of the iburst: send the next request, read an answer or
+  handle timeouts. After all requests are done the samples are applied.
+*/
+uint8_t precise_sntp::iburst_step() {
+  // send the next request, if it is time and a slot is free
+  if ((_iburst.sent < _iburst.requests) &&
+      ((_iburst.sent == 0) ||
+       (millis() - _iburst_last_send >= _iburst_interval))) {
+    for (uint8_t i = 0; i < PRECISE_SNTP_IBURST_SLOTS; i++) {
+      struct precise_sntp_iburst_slot *slot = &(_iburst_slots[i]);
+      if (slot->used) {
+	continue;
+      }
+      _association = _iburst.sent % _number_of_associations;
+      _associations[_association].reach <<= 1;
+      _iburst.sent++;
+      _iburst_last_send = millis();
+      const uint8_t ret = _associations[_association].denied ? 11 :
+	send_packet(&(_associations[_association]));
+      if (ret != 0) {
+	store_result(ret);
+	_iburst.failed++;
+	_iburst.last_error = ret;
+      } else {
+	slot->used = true;
+	slot->association = _association;
+	slot->xmt = _xmt;
+	slot->t1 = (unsigned long) _t1_ticks;
+	slot->sent = _iburst_last_send;
+      }
+      return PRECISE_SNTP_POLL_PENDING;
+    }
+  }
+  // read an answer and match it to the waiting requests
+  if (NTP_UDP(parsePacket)() == NTP_PACKET_SIZE) {
+    const uint64_t now = get_ticks();
+    struct ntp_timestamp_format_struct xmt[PRECISE_SNTP_IBURST_SLOTS];
+    uint8_t index[PRECISE_SNTP_IBURST_SLOTS];
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < PRECISE_SNTP_IBURST_SLOTS; i++) {
+      if (_iburst_slots[i].used) {
+	xmt[n] = _iburst_slots[i].xmt;
+	index[n++] = i;
+      }
+    }
+    const uint8_t ret = read_reply(NTP_PACKET_VIEW_MODE_SERVER, xmt, n);
+    if (_reply_index < n) {
+      // an answer to a waiting request (otherwise a late or bogus one,
+      // the request runs into the timeout)
+      struct precise_sntp_iburst_slot *slot =
+	&(_iburst_slots[index[_reply_index]]);
+      slot->used = false;
+      _association = slot->association;
+      store_result(ret);
+      if (ret == 0) {
+	_t1_ticks = now - (uint32_t) (((uint32_t) now) - ((uint32_t) slot->t1));
+	_t4_ticks = receive_ticks(_t1_ticks, now);
+	add_sample();
+	_iburst.valid++;
+      } else {
+	_iburst.failed++;
+	_iburst.last_error = ret;
+      }
+    }
+    return PRECISE_SNTP_POLL_PENDING;
+  }
+  // requests without answer
+  bool waiting = false;
+  for (uint8_t i = 0; i < PRECISE_SNTP_IBURST_SLOTS; i++) {
+    struct precise_sntp_iburst_slot *slot = &(_iburst_slots[i]);
+    if (!slot->used) {
+      continue;
+    }
+    if (millis() - slot->sent < PRECISE_SNTP_REPLY_TIMEOUT) {
+      waiting = true;
+      continue;
+    }
+    slot->used = false;
+    _association = slot->association;
+    store_result(6);
+    _iburst.failed++;
+    _iburst.last_error = 6;
+  }
+  if (waiting || (_iburst.sent < _iburst.requests)) {
+    return PRECISE_SNTP_POLL_PENDING;
+  }
+  if (!_round_success) {
+    return finish_poll(_round_result);
+  }
+  _poll_state = PRECISE_SNTP_POLL_APPLY;
+  return PRECISE_SNTP_POLL_PENDING;
+}
+
+bool precise_sntp::begin_broadcast(uint16_t port) {
+  if (_poll_state != PRECISE_SNTP_POLL_IDLE) {
+    return false;
+  }
+  _broadcast = false;
+  // calibrate the delay to each server, the first answer only sets the
+  // clock and gives no delay
+  if ((!_clock_set) && (force_update() != 0)) {
+    return false;
+  }
+  if (force_update() != 0) {
+    return false;
+  }
+  bool calibrated = false;
+  for (uint8_t i = 0; i < _number_of_associations; i++) {
+    struct precise_sntp_association *a = &(_associations[i]);
+    a->broadcast_delay = 0;
+    if ((a->reach & 1) && (a->filter.count > 0)) {
+      a->broadcast_delay = a->filter.delay;
+      calibrated = true;
+    }
+  }
+  if ((!calibrated) || (NTP_UDP(begin)(port) != 1)) {
+    return false;
+  }
+  _broadcast = true;
+  return true;
+}
+
+void precise_sntp::end_broadcast() {
+  _broadcast = false;
+}
+
+/*
+  Reads a waiting broadcast packet and corrects the local clock
+  (see begin_broadcast()). The sample is processed like the answer of
+  a poll, but in one step.
+
+  returns 1, if no packet is waiting, 7 for an unknown sender, otherwise
+  the error code of the poll
+*/
+uint8_t precise_sntp::receive_broadcast() {
+  if (NTP_UDP(parsePacket)() != NTP_PACKET_SIZE) {
+    return 1;
+  }
+  const uint64_t t4_ticks = get_ticks();
+  const IPAddress ip = NTP_UDP(remoteIP)();
+  uint8_t i = 0;
+  while ((i < _number_of_associations) &&
+	 ((_associations[i].broadcast_delay == 0) ||
+	  _associations[i].denied || (!(_associations[i].ip == ip)))) {
+    i++;
+  }
+  if (i == _number_of_associations) {
+#ifdef PRECISE_SNTP_DEBUG
+    Serial.println("broadcast packet of unknown sender");
+#endif
+    return 7;
+  }
+  begin_poll();
+  _association = i;
+  _associations[i].reach <<= 1;
+  // the hook may only move the receive time back up to one second
+  _t4_ticks = receive_ticks((t4_ticks > PRECISE_SNTP_TICKS_PER_SECOND) ?
+			    t4_ticks - PRECISE_SNTP_TICKS_PER_SECOND : 0,
+			    t4_ticks);
+  const uint8_t ret = read_reply(NTP_PACKET_VIEW_MODE_BROADCAST, NULL, 0);
+  if (ret != 0) {
+    return finish_poll(ret);
+  }
+  add_sample();
+  return apply_samples();
+}
+
+uint8_t precise_sntp::send_request() {
 #ifdef PRECISE_SNTP_DEBUG
   Serial.println("update");
   Serial.print("_poll_exponent ");
   Serial.println(_poll_exponent);
 #endif
+  _associations[_association].reach <<= 1;
+  if (_associations[_association].denied) {
+    return next_association(11);
+  }
+  const uint8_t ret = send_packet(&(_associations[_association]));
+  if (ret != 0) {
+    return next_association(ret);
+  }
+  _start_waiting = millis();
+  _poll_state = PRECISE_SNTP_POLL_AWAIT_REPLY;
+  return PRECISE_SNTP_POLL_PENDING;
+}
+
+/*
+  Sends a request with a new opaque transmit timestamp _xmt to the server.
+  The send time is stored in _t1_ticks.
+
+  returns 0 or the error codes 2, 3, 4 or 5
+*/
+uint8_t precise_sntp::send_packet(struct precise_sntp_association *server) {
   union ntp_packet_union ntp_packet;
   memset(ntp_packet.as_bytes, 0, NTP_PACKET_SIZE);
   // set leap=3 (no warning), version=4, mode=3 (client):
   ntp_packet.as_ntp_packet.leap_version_mode = 0xE3;
   ntp_packet.as_ntp_packet.stratum = 0; // stratum=0 (unspecified or invalid)
   ntp_packet.as_ntp_packet.poll = _poll_exponent; // poll=6 (default min poll interval)
-  ntp_packet.as_ntp_packet.precision = 0xEC;
-  const struct ntp_timestamp_format_struct t1 = get_local_clock();
-  ntp_packet.as_ntp_packet.xmt = t1;
-  ntp_timestamp_format_hton(&(ntp_packet.as_ntp_packet.xmt));
-  if (_udp->begin(_localport) != 1) {
+  ntp_packet.as_ntp_packet.precision = (byte) NTP_LOCAL_PRECISION_EXPONENT;
+  // The transmit timestamp is only an opaque cookie to match the answer
+  // (origin timestamp). The real send time T1 is taken after endPacket(),
+  // since begin(), beginPacket() (maybe a name resolution) and endPacket()
+  // can take a long time, which would be counted as network delay.
+  _xmt.seconds = random32();
+  _xmt.fraction = random32();
+  // in network byte order independent of the host (as decoded by
+  // precise_sntp_ntp_packet_view)
+  for (uint8_t i = 0; i < 4; i++) {
+    ntp_packet.as_bytes[NTP_PACKET_VIEW_XMT + i] =
+      (byte) (_xmt.seconds >> (24 - 8 * i));
+    ntp_packet.as_bytes[NTP_PACKET_VIEW_XMT + 4 + i] =
+      (byte) (_xmt.fraction >> (24 - 8 * i));
+  }
+  if (NTP_UDP(begin)(PRECISE_SNTP_LOCAL_PORT) != 1) {
 #ifdef PRECISE_SNTP_DEBUG
-    Serial.println("_localport not working");
+    Serial.println("local port not working");
 #endif
     return 2;
   }
-  if (_ntp_server_name) {
-    if (_udp->beginPacket(_ntp_server_name, 123) != 1) {
+  if (server->name && _resolver) {
+    resolve_association(server);
+  }
+  if (server->name && ((!server->resolved) || (!_resolver))) {
+    if (NTP_UDP(beginPacket)(server->name,
+			     PRECISE_SNTP_SERVER_PORT) != 1) {
 #ifdef PRECISE_SNTP_DEBUG
       Serial.println("cannot start connection");
 #endif
-      _next_update_period += 1000;
       return 3;
     }
   } else {
-    if (_udp->beginPacket(_ntp_server_ip, 123) != 1) {
+    if (NTP_UDP(beginPacket)(server->ip, PRECISE_SNTP_SERVER_PORT) != 1) {
 #ifdef PRECISE_SNTP_DEBUG
       Serial.println("cannot start connection");
 #endif
-      _next_update_period += 1000;
       return 3;
     }
   }
-  if (_udp->write(ntp_packet.as_bytes, NTP_PACKET_SIZE) != NTP_PACKET_SIZE) {
+  if (NTP_UDP(write)(ntp_packet.as_bytes, NTP_PACKET_SIZE) !=
+      NTP_PACKET_SIZE) {
 #ifdef PRECISE_SNTP_DEBUG
     Serial.println("problems writing data");
 #endif
-    _next_update_period += 1000;
     return 4;
   }
-  if (_udp->endPacket() != 1) {
+  if (NTP_UDP(endPacket)() != 1) {
 #ifdef PRECISE_SNTP_DEBUG
     Serial.println("packet was not send");
 #endif
-    _next_update_period += 1000;
     return 5;
   }
-  unsigned long start_waiting = millis();
-  int packetSize;
-  while (((packetSize = _udp->parsePacket()) != NTP_PACKET_SIZE) &&
-	 (millis() - start_waiting < 1000)) {
-    // Wait until all data received. But wait maximal 1000 milliseconds.
-    // If millis overflows it is less 1000 milliseconds and
-    // otherwise it waits up to 1000 milliseconds for an answer.
-  }
-  if (packetSize != NTP_PACKET_SIZE) {
+  _t1_ticks = get_ticks();
+#ifdef PRECISE_SNTP_STATISTICS
+  _statistics.requests++;
+#endif
+  return 0;
+}
+
+uint8_t precise_sntp::await_reply() {
+  if (NTP_UDP(parsePacket)() != NTP_PACKET_SIZE) {
+    // Wait until all data received. But wait maximal
+    // PRECISE_SNTP_REPLY_TIMEOUT milliseconds. If millis overflows it is
+    // less PRECISE_SNTP_REPLY_TIMEOUT milliseconds and otherwise it waits
+    // up to PRECISE_SNTP_REPLY_TIMEOUT milliseconds for an answer.
+    if (millis() - _start_waiting < PRECISE_SNTP_REPLY_TIMEOUT) {
+      return PRECISE_SNTP_POLL_PENDING;
+    }
 #ifdef PRECISE_SNTP_DEBUG
     Serial.println("got no answer from server");
 #endif
-    _next_update_period += 1000;
-    return 6;
-  }
-  const struct ntp_timestamp_format_struct t4 = get_local_clock();
-  _udp->read(ntp_packet.as_bytes, NTP_PACKET_SIZE);
-  // adapt byte order (skipping not used values):
-  // ntp_short_format_ntoh(&ntp_packet.as_ntp_packet.rootdelay);
-  // ntp_short_format_ntoh(&ntp_packet.as_ntp_packet.rootdisp);
+    return next_association(6);
+  }
+  _t4_ticks = receive_ticks(_t1_ticks, get_ticks());
+  _poll_state = PRECISE_SNTP_POLL_VALIDATE;
+  return PRECISE_SNTP_POLL_PENDING;
+}
+
+/*
+  returns the extended ticks when the answer to a request sent at t1_ticks
+  was received, t4_ticks is the time the answer was noticed
+*/
+uint64_t precise_sntp::receive_ticks(uint64_t t1_ticks, uint64_t t4_ticks) {
+  unsigned long ticks;
+  if (_receive_timestamp_hook && _receive_timestamp_hook(&ticks)) {
+    // the driver knows when the packet was really received,
+    // only use it if it was received after sending the request
+    const uint32_t age = ((uint32_t) t4_ticks) - ((uint32_t) ticks);
+    if (age <= t4_ticks - t1_ticks) {
+      t4_ticks -= age;
+    }
+  }
+  return t4_ticks;
+}
+
+uint8_t precise_sntp::validate_reply() {
+  const uint8_t ret = read_reply(NTP_PACKET_VIEW_MODE_SERVER, &_xmt, 1);
+  if (ret != 0) {
+    return next_association(ret);
+  }
+  _poll_state = PRECISE_SNTP_POLL_FILTER;
+  return PRECISE_SNTP_POLL_PENDING;
+}
+
+/*
+  Reads and checks the answer of a server with the expected mode
+  (NTP_PACKET_VIEW_MODE_SERVER or NTP_PACKET_VIEW_MODE_BROADCAST). The
+  origin timestamp of a server answer has to match one of the n transmit
+  timestamps xmt, for a broadcast packet xmt is not used. T2, T3 and the
+  precision of the server are stored in _t2, _t3 and _server_precision.
+
+  returns 0, the error codes 7, 8, 10, 11 or 12, and in _reply_index the
+  matching transmit timestamp
+*/
+uint8_t precise_sntp::read_reply(uint8_t mode,
+				 const struct ntp_timestamp_format_struct *xmt,
+				 uint8_t n) {
+  uint8_t buffer[NTP_PACKET_SIZE];
+  const int size = NTP_UDP(read)(buffer, NTP_PACKET_SIZE);
+  // the fields are decoded from the buffer when needed
+  const precise_sntp_ntp_packet_view packet(buffer);
+  const uint8_t ret =
+    packet.check((size > 0) ? (size_t) size : 0, mode, xmt, n,
+		 &_reply_index);
+  if (ret != 0) {
 #ifdef PRECISE_SNTP_DEBUG
-  ntp_timestamp_format_ntoh(&ntp_packet.as_ntp_packet.reftime);
+    if (ret == 7) {
+      Serial.println("sanity check fail, answer from server is bogus");
+    } else if (ret == 8) {
+      Serial.println("sanity check fail, server is not syncronized");
+    } else if (ret == 10) {
+      Serial.println("kiss code RATE, server limits the rate");
+    } else {
+      Serial.println("kiss code DENY or RSTR, server denies access");
+    }
 #endif
-  ntp_timestamp_format_ntoh(&ntp_packet.as_ntp_packet.org);
-  ntp_timestamp_format_ntoh(&ntp_packet.as_ntp_packet.rec);
-  ntp_timestamp_format_ntoh(&ntp_packet.as_ntp_packet.xmt);
-  // sanity check
-  if ((t1.seconds != ntp_packet.as_ntp_packet.org.seconds) ||
-      (t1.fraction != ntp_packet.as_ntp_packet.org.fraction)) {
+    return ret;
+  }
+  const uint32_t rootdelay = packet.rootdelay();
+  const uint32_t rootdisp = packet.rootdisp();
+  // synchronization distance of the server: rootdelay / 2 + rootdisp
+  if ((((uint64_t) rootdelay) << 15) + (((uint64_t) rootdisp) << 16) >
+      NTP_MILLIS2DURATION(_max_distance)) {
 #ifdef PRECISE_SNTP_DEBUG
-    Serial.println("sanity check fail, answer from server is bogus");
+    Serial.println("synchronization distance of server too large");
 #endif
-    _next_update_period += 1000;
-    return 7;
+    return 12;
   }
-  if ((ntp_packet.as_ntp_packet.stratum < 1) ||
-      (15 < ntp_packet.as_ntp_packet.stratum)) {
 #ifdef PRECISE_SNTP_DEBUG
-    Serial.println("sanity check fail, server is not syncronized");
+  Serial.print("poll: ");
+  Serial.println(packet.poll());
+  Serial.print("statum: ");
+  Serial.println(packet.stratum());
+  Serial.print(" reftime ");
+  Serial.println(packet.reftime().seconds);
+  Serial.print(" org ");
+  Serial.println(packet.org().seconds);
+  Serial.print(" rec ");
+  Serial.println(packet.rec().seconds);
+  Serial.print(" xmt ");
+  Serial.println(packet.xmt().seconds);
 #endif
-    // handle stratum == 0 as KoD
-    _next_update_period += 1000 * (1 << _min_poll_exponent);
-    return 8;
-  }
-  // go on
-  _last_update = millis();
-  const struct ntp_timestamp_format_struct t2 = ntp_packet.as_ntp_packet.rec;
-  const struct ntp_timestamp_format_struct t3 = ntp_packet.as_ntp_packet.xmt;
-  if (ntp_packet.as_ntp_packet.poll < _min_poll_exponent) {
-    _poll_exponent = _min_poll_exponent;
-  } else if (_max_poll_exponent < ntp_packet.as_ntp_packet.poll) {
-    _poll_exponent = _max_poll_exponent;
-  } else {
-    _poll_exponent = ntp_packet.as_ntp_packet.poll;
+  _t2 = packet.rec();
+  _t3 = packet.xmt();
+  _reply_poll = packet.poll();
+  _reply_leap = packet.leap();
+  _reply_stratum = packet.stratum();
+  _reply_rootdelay = rootdelay;
+  _reply_rootdisp = rootdisp;
+  _server_precision = packet.precision();
+  return 0;
+}
+
+uint8_t precise_sntp::filter_reply() {
+  add_sample();
+  return next_association(0);
+}
+
+/*
+  Feeds the checked answer of the server _association (_t1_ticks, _t2, _t3
+  and _t4_ticks) into its clock filter or sets the clock.
+*/
+void precise_sntp::add_sample() {
+  struct precise_sntp_association *server = &(_associations[_association]);
+  server->reach |= 1;
+  // devices started at the same time (same seed) diverge by the
+  // receive timestamps of the server
+  _random_state ^= _t2.fraction;
+  if (_random_state == 0) {
+    _random_state = 1;
   }
-  _next_update_period = 1000 * (1 << _poll_exponent);
+  server->poll = _reply_poll;
+  server->leap = _reply_leap;
+  server->stratum = _reply_stratum;
+  server->rootdelay = _reply_rootdelay;
+  server->rootdisp = _reply_rootdisp;
+  // using the own clock, we can calculate here some statistics, e. g.:
+  // offset theta of B relative to A:
+  const uint64_t T3 = ntp_timestamp_format2uint64(_t3);
+  const uint64_t T4 = ticks2clock(_t4_ticks);
+  // a broadcast packet has no receive timestamp: the calibrated
+  // round-trip delay gives T1 and T2 (theta = T3 + delay / 2 - T4)
+  const uint64_t T1 = _broadcast ? T4 - server->broadcast_delay :
+    ticks2clock(_t1_ticks);
+  const uint64_t T2 = _broadcast ? T3 : ntp_timestamp_format2uint64(_t2);
 #ifdef PRECISE_SNTP_DEBUG
   Serial.print("t1: ");
-  Serial.print(t1.seconds);
+  Serial.print((uint32_t) (T1 >> 32));
   Serial.print(".");
-  Serial.println(t1.fraction);
+  Serial.println((uint32_t) T1);
   Serial.print("t2: ");
-  Serial.print(t2.seconds);
+  Serial.print(_t2.seconds);
   Serial.print(".");
-  Serial.println(t2.fraction);
+  Serial.println(_t2.fraction);
   Serial.print("t3: ");
-  Serial.print(t3.seconds);
+  Serial.print(_t3.seconds);
   Serial.print(".");
-  Serial.println(t3.fraction);
+  Serial.println(_t3.fraction);
   Serial.print("t4: ");
-  Serial.print(t4.seconds);
+  Serial.print((uint32_t) (T4 >> 32));
   Serial.print(".");
-  Serial.println(t4.fraction);
+  Serial.println((uint32_t) T4);
 #endif
-  // using the own clock, we can calculate here some statistics, e. g.:
-  // offset theta of B relative to A:
-  const uint64_t T1 = (((uint64_t) t1.seconds) << 32) + t1.fraction;
-  const uint64_t T2 = (((uint64_t) t2.seconds) << 32) + t2.fraction;
-  const uint64_t T3 = (((uint64_t) t3.seconds) << 32) + t3.fraction;
-  const uint64_t T4 = (((uint64_t) t4.seconds) << 32) + t4.fraction;
+  if (((!_clock_set) || (_use_transmit_timestamp)) && (!_round_stepped)) {
+    // the clock was never set or it is requested,
+    // we will use the transmit timestamp of the server
+#ifdef PRECISE_SNTP_DEBUG
+    Serial.println("we will use the transmit timestamp of the server");
+#endif
+    set_local_clock(T3);
+    clear_filters();
+    _round_stepped = true;
+    return;
+  }
   // calculate offset theta from ntp server
   // theta = 0.5 * (T2+T3) - 0.5 * (T1+T4)
-  const int64_t theta = 0.5 * (((int64_t) T2 - (int64_t) T1) +
-			       ((int64_t) T3 - (int64_t) T4));
+  // (integer arithmetic, the differences are interpreted as signed values
+  // like in RFC 5905; valid for offsets up to about 34 years)
+  const int64_t theta = ((int64_t) ((T2 - T1) + (T3 - T4))) / 2;
+  // calculate the round-trip delay (at least the local precision):
+  // delta = (T4-T1) - (T3-T2)
+  uint64_t delta = NTP_LOCAL_PRECISION;
+  if ((int64_t) ((T4 - T1) - (T3 - T2)) > (int64_t) NTP_LOCAL_PRECISION) {
+    delta = (T4 - T1) - (T3 - T2);
+  }
+  // dispersion of the sample: precisions and frequency tolerance
+  const uint64_t epsilon = NTP_LOCAL_PRECISION +
+    precision2duration(_server_precision) + ((T4 - T1) >> NTP_PHI_SHIFT);
 #ifdef PRECISE_SNTP_DEBUG
   Serial.print("theta [ms]: ");
   Serial.println((int16_t) (((theta >> 16) * 1000) >> 16));
   Serial.print("theta [us]: ");
   Serial.println((int16_t) (((theta >> 16) * 1000000) >> 16));
-  // calculate the round-trip delay:
-  const uint64_t delta = (T4 - T1) - (T3 - T2);
   Serial.print("delta [ms]: ");
   Serial.println((uint16_t) (((delta >> 16) * 1000) >> 16));
   Serial.print("delta [us]: ");
   Serial.println((uint16_t) (((delta >> 16) * 1000000) >> 16));
-  Serial.print("poll: ");
-  Serial.println(ntp_packet.as_ntp_packet.poll);
-  Serial.print("statum: ");
-  Serial.println(ntp_packet.as_ntp_packet.stratum);
 #endif
-  if ((((uint64_t) abs(theta)) > (((uint64_t) 1)<<32)) ||
-      (use_transmit_timestamp)) {
-    // large error, we will use the transmit timestamp of the server
+  if (((uint64_t) abs(theta)) > NTP_STEP_THRESHOLD) {
+    // large error, the older samples of this server are not comparable
+    clock_filter_clear(&(server->filter));
+  }
+  clock_filter_add(&(server->filter), theta, delta, epsilon, millis());
+#ifdef PRECISE_SNTP_STATISTICS
+  statistics_add_sample(theta, delta, epsilon);
+#endif
+  if (clock_filter_select(&(server->filter), millis())) {
+    server->new_sample = true;
+  }
+}
+
+/*
+  Selection and cluster algorithms of RFC 5905 section 11.2.
+
+  The correctness interval of each server is its offset +- its root
+  distance. The intersection of the intervals of the majority of the
+  servers (Marzullo's algorithm) gives the truechimers. The truechimers
+  are reduced by the cluster algorithm to the ones with low jitter.
+
+  returns the number of survivors, survivors[] and distance[] are filled
+  sorted by the root distance (the first one is the system peer)
+*/
+uint8_t precise_sntp::select_clock(unsigned long now, uint8_t *survivors,
+				   uint64_t *distance) {
+  struct {
+    int64_t edge;
+    int8_t type; // -1: lower edge, 0: midpoint, 1: upper edge
+  } edges[3 * PRECISE_SNTP_MAX_SERVERS];
+  uint8_t candidates[PRECISE_SNTP_MAX_SERVERS];
+  uint64_t lambda[PRECISE_SNTP_MAX_SERVERS];
+  uint8_t n = 0;
+  uint8_t n_edges = 0;
+  for (uint8_t i = 0; i < _number_of_associations; i++) {
+    const struct precise_sntp_association *a = &(_associations[i]);
+    if ((a->reach == 0) || (a->filter.count == 0)) {
+      continue;
+    }
+    candidates[n] = i;
+    lambda[n] = root_distance(a, now);
+    const int64_t l = (lambda[n] > (uint64_t) INT64_MAX) ? INT64_MAX :
+      (int64_t) lambda[n];
+    const int64_t edge[3] = {saturating_sub(a->filter.offset, l),
+			     a->filter.offset,
+			     saturating_add(a->filter.offset, l)};
+    for (int8_t type = -1; type <= 1; type++) {
+      // sort by edge, on equal edges lower edges first
+      uint8_t j = n_edges;
+      while ((j > 0) &&
+	     ((edges[j - 1].edge > edge[type + 1]) ||
+	      ((edges[j - 1].edge == edge[type + 1]) &&
+	       (edges[j - 1].type > type)))) {
+	edges[j] = edges[j - 1];
+	j--;
+      }
+      edges[j].edge = edge[type + 1];
+      edges[j].type = type;
+      n_edges++;
+    }
+    n++;
+  }
+  if (n == 0) {
+    return 0;
+  }
+  // find the intersection interval [low, high] of the majority,
+  // allowing more and more falsetickers
+  int64_t low = 0;
+  int64_t high = 0;
+  bool found_intersection = false;
+  for (uint8_t allow = 0; 2 * allow < n; allow++) {
+    uint8_t found = 0; // midpoints outside the intersection
+    int8_t chime = 0;
+    for (uint8_t i = 0; i < n_edges; i++) {
+      chime -= edges[i].type;
+      if (chime >= n - allow) {
+	low = edges[i].edge;
+	break;
+      }
+      if (edges[i].type == 0) {
+	found++;
+      }
+    }
+    chime = 0;
+    for (uint8_t i = n_edges; i > 0; i--) {
+      chime += edges[i - 1].type;
+      if (chime >= n - allow) {
+	high = edges[i - 1].edge;
+	break;
+      }
+      if (edges[i - 1].type == 0) {
+	found++;
+      }
+    }
+    if ((found <= allow) && (high > low)) {
+      found_intersection = true;
+      break;
+    }
+  }
+  if (!found_intersection) {
+    return 0;
+  }
+  // the truechimers have their offset in the intersection interval,
+  // they are sorted by root distance
+  uint8_t number_of_survivors = 0;
+  for (uint8_t i = 0; i < n; i++) {
+    const int64_t offset = _associations[candidates[i]].filter.offset;
+    if ((offset < low) || (high < offset)) {
+      continue;
+    }
+    uint8_t j = number_of_survivors;
+    while ((j > 0) && (distance[j - 1] > lambda[i])) {
+      survivors[j] = survivors[j - 1];
+      distance[j] = distance[j - 1];
+      j--;
+    }
+    survivors[j] = candidates[i];
+    distance[j] = lambda[i];
+    number_of_survivors++;
+  }
+  // cluster algorithm: discard the survivor with the largest selection
+  // jitter as long as it is larger than the smallest peer jitter
+  while (number_of_survivors > NTP_MINCLOCK) {
+    uint64_t max_selection_jitter = 0;
+    uint8_t max_index = 0;
+    uint64_t min_peer_jitter = ~((uint64_t) 0);
+    for (uint8_t i = 0; i < number_of_survivors; i++) {
+      const struct precise_sntp_clock_filter *f =
+	&(_associations[survivors[i]].filter);
+      uint64_t sum = 0;
+      for (uint8_t j = 0; j < number_of_survivors; j++) {
+	const int64_t diff = offset_difference(
+	  _associations[survivors[j]].filter.offset, f->offset);
+	sum += (uint64_t) (diff * diff);
+      }
+      const uint64_t selection_jitter =
+	precise_sntp_isqrt64(sum / (number_of_survivors - 1)) << 16;
+      if (selection_jitter > max_selection_jitter) {
+	max_selection_jitter = selection_jitter;
+	max_index = i;
+      }
+      if (f->jitter < min_peer_jitter) {
+	min_peer_jitter = f->jitter;
+      }
+    }
+    if (max_selection_jitter <= min_peer_jitter) {
+      break;
+    }
+    for (uint8_t i = max_index + 1; i < number_of_survivors; i++) {
+      survivors[i - 1] = survivors[i];
+      distance[i - 1] = distance[i];
+    }
+    number_of_survivors--;
+  }
+  return number_of_survivors;
+}
+
+uint8_t precise_sntp::apply_samples() {
+  const unsigned long now = millis();
+  uint8_t survivors[PRECISE_SNTP_MAX_SERVERS];
+  uint64_t distance[PRECISE_SNTP_MAX_SERVERS];
+  // if the clock was set in this poll, only the later samples are in the
+  // filters, maybe none
+  const uint8_t number_of_survivors = select_clock(now, survivors, distance);
+  _number_of_survivors = number_of_survivors;
+  if (number_of_survivors > 0) {
+    _system_peer = survivors[0];
+  } else if (!_round_stepped) {
+#ifdef PRECISE_SNTP_DEBUG
+    Serial.println("no majority of the servers agrees on the time");
+#endif
+    return finish_poll(9);
+  }
+  _last_update = now;
+  _poll_exponent = clamp_poll_exponent(_associations[_system_peer].poll);
+  _next_update_period = 1000 * (1 << _poll_exponent);
+  // combine the offsets of the survivors weighted by 1 / root distance,
+  // but only if one of them has a new sample
+  bool new_sample = false;
+  unsigned long sample_time = 0;
+  for (uint8_t i = 0; i < number_of_survivors; i++) {
+    const struct precise_sntp_association *a = &(_associations[survivors[i]]);
+    if (a->new_sample &&
+	((!new_sample) || ((long) (a->filter.last_used - sample_time) > 0))) {
+      sample_time = a->filter.last_used;
+      new_sample = true;
+    }
+  }
+  if (new_sample) {
+    // weighted mean relative to the system peer to avoid an overflow
+    const int64_t reference = _associations[survivors[0]].filter.offset;
+    int64_t sum = 0;
+    int64_t weights = 0;
+    for (uint8_t i = 0; i < number_of_survivors; i++) {
+      int64_t diff =
+	saturating_sub(_associations[survivors[i]].filter.offset, reference);
+      if (diff > (((int64_t) 1) << 36)) {
+	diff = ((int64_t) 1) << 36;
+      } else if (diff < -(((int64_t) 1) << 36)) {
+	diff = -(((int64_t) 1) << 36);
+      }
+      const uint64_t d = distance[i] >> 16;
+      int64_t weight = (((int64_t) 1) << 24) / (int64_t) (d > 0 ? d : 1);
+      if (weight < 1) {
+	weight = 1;
+      }
+      sum += diff * weight;
+      weights += weight;
+    }
+    const int64_t correction = saturating_add(reference, sum / weights);
+    // the clock including the correction not slewed yet
+    const uint64_t ticks = get_ticks();
+    const uint64_t now_clock = ticks2clock(ticks);
+    _round_offset = correction;
+    _round_corrected = true;
+    if (((uint64_t) abs(correction)) > NTP_STEP_THRESHOLD) {
+      // large error, step the clock
 #ifdef PRECISE_SNTP_DEBUG
-    Serial.println("large error, we will use the transmit timestamp of the server");
+      Serial.println("large error, step the clock");
 #endif
-    _ntp_local_clock.as_timestamp.seconds =
-      ntp_packet.as_ntp_packet.xmt.seconds;
-    _ntp_local_clock.as_timestamp.fraction =
-      ntp_packet.as_ntp_packet.xmt.fraction;
-    _last_clock_update = millis();
-    _millis_overflow_count = 0;
-  } else {
-    const uint64_t my_local_clock =
-      (int64_t) _ntp_local_clock_union2uint64(_ntp_local_clock) + theta;
-    _ntp_local_clock.as_timestamp.seconds = (uint32_t) (my_local_clock >> 32);
-    _ntp_local_clock.as_timestamp.fraction =
-      (uint32_t) (my_local_clock & 0x00000000FFFFFFFFULL);
+      anchor_clock(now_clock + correction, ticks, 0);
+      clear_filters();
+      _clock_jitter = 0;
+      _last_offset = 0;
+    } else {
+      update_clock_jitter(correction);
+      // correct the time using the combined offset
+      if (_clock.slew_rate > 0) {
+	// slew the correction, the pending part of the former ones stays
+	const uint64_t slewed_clock = clock_state2clock(&_clock, ticks);
+	anchor_clock(slewed_clock, ticks,
+		     (int64_t) (now_clock - slewed_clock) + correction);
+      } else {
+	anchor_clock(now_clock + correction, ticks, 0);
+      }
+      // the new frequency must only be used after re-anchoring the clock
+      if (_correction_used) {
+	discipline_frequency(correction, sample_time - _last_correction);
+      }
+      for (uint8_t i = 0; i < _number_of_associations; i++) {
+	clock_filter_correct(&(_associations[i].filter), correction);
+      }
+      _correction_used = true;
+      _last_correction = sample_time;
+    }
   }
 #ifdef PRECISE_SNTP_DEBUG
-  Serial.print(" reftime ");
-  Serial.println(ntp_packet.as_ntp_packet.reftime.seconds);
-  Serial.print(" org ");
-  Serial.println(ntp_packet.as_ntp_packet.org.seconds);
-  Serial.print(" rec ");
-  Serial.println(ntp_packet.as_ntp_packet.rec.seconds);
-  Serial.print(" xmt ");
-  Serial.println(ntp_packet.as_ntp_packet.xmt.seconds);
-  uint32_t epoch = _ntp_local_clock.as_timestamp.seconds - 2208988800UL;
+  uint32_t epoch = _clock.clock.as_timestamp.seconds - 2208988800UL;
   uint16_t epoch_milli =
     (uint16_t) (((float) 1000) *
-		(((float) (_ntp_local_clock.as_timestamp.fraction >> 22)) /
+		(((float) (_clock.clock.as_timestamp.fraction >> 22)) /
 		 ((float) (1<<10))));
   Serial.print(epoch);
   Serial.print(".");
@@ -337,27 +1545,332 @@ uint8_t precise_sntp::force_update(bool use_transmit_timestamp) {
   Serial.print(epoch_milli);
   double fepoch =
     (double) epoch +
-    (((double) _ntp_local_clock.as_timestamp.fraction) /
+    (((double) _clock.clock.as_timestamp.fraction) /
      ((double) 4294967295UL)); // ~= seconds + fraction / (2**32)
   Serial.print(" ");
   Serial.println(fepoch);
 #endif
-  _is_synced = true;
-  return 0;
+  return finish_poll(0);
+}
+
+#ifdef PRECISE_SNTP_STATISTICS
+/*
+  returns the histogram bucket of the absolute value x
+  (in units of 2^-32 s, see struct precise_sntp_statistics)
+*/
+static uint8_t statistics_bucket(uint64_t x) {
+  uint8_t bucket = 0;
+  x >>= 12;
+  while ((x > 0) && (bucket < PRECISE_SNTP_STATISTICS_BUCKETS - 1)) {
+    x >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+/*
+  Adds a raw sample of the server _association to the statistics.
+*/
+void precise_sntp::statistics_add_sample(int64_t offset, uint64_t delay,
+					 uint64_t dispersion) {
+  if ((_statistics.samples == 0) || (offset < _statistics.offset_min)) {
+    _statistics.offset_min = offset;
+  }
+  if ((_statistics.samples == 0) || (offset > _statistics.offset_max)) {
+    _statistics.offset_max = offset;
+  }
+  if ((_statistics.samples == 0) || (delay < _statistics.delay_min)) {
+    _statistics.delay_min = delay;
+  }
+  if (delay > _statistics.delay_max) {
+    _statistics.delay_max = delay;
+  }
+  _statistics.samples++;
+  // the means use the samples clamped to PRECISE_SNTP_STATISTICS_MEAN_LIMIT,
+  // the sums saturate (after more than 2^23 samples at the limit)
+  const int64_t limit = PRECISE_SNTP_STATISTICS_MEAN_LIMIT;
+  _statistics_offset_sum = saturating_add(
+    _statistics_offset_sum,
+    (offset > limit) ? limit : ((offset < -limit) ? -limit : offset));
+  const uint64_t clamped_delay = (delay > (uint64_t) limit) ? limit : delay;
+  _statistics_delay_sum =
+    (_statistics_delay_sum > UINT64_MAX - clamped_delay) ?
+    UINT64_MAX : _statistics_delay_sum + clamped_delay;
+  _statistics.offset_histogram[statistics_bucket(
+      (offset < 0) ? 0 - (uint64_t) offset : (uint64_t) offset)]++;
+  _statistics.delay_histogram[statistics_bucket(delay)]++;
+  struct precise_sntp_statistics_sample *sample =
+    &(_statistics_samples[_statistics_next_sample]);
+  sample->time = millis();
+  sample->server = _association;
+  sample->offset = offset;
+  sample->delay = delay;
+  sample->dispersion = dispersion;
+  _statistics_next_sample =
+    (_statistics_next_sample + 1) % PRECISE_SNTP_STATISTICS_SAMPLES;
+}
+
+struct precise_sntp_statistics precise_sntp::get_statistics() {
+  struct precise_sntp_statistics statistics = _statistics;
+  statistics.poll_exponent = _poll_exponent;
+  if (statistics.samples > 0) {
+    statistics.offset_mean =
+      _statistics_offset_sum / (int64_t) statistics.samples;
+    statistics.delay_mean = _statistics_delay_sum / statistics.samples;
+  }
+  statistics.number_of_samples =
+    (statistics.samples < PRECISE_SNTP_STATISTICS_SAMPLES) ?
+    (uint8_t) statistics.samples : PRECISE_SNTP_STATISTICS_SAMPLES;
+  // copy the ring buffer, the newest sample first
+  for (uint8_t i = 0; i < statistics.number_of_samples; i++) {
+    statistics.last_samples[i] = _statistics_samples[
+      (_statistics_next_sample + PRECISE_SNTP_STATISTICS_SAMPLES - 1 - i) %
+      PRECISE_SNTP_STATISTICS_SAMPLES];
+  }
+  return statistics;
+}
+
+void precise_sntp::reset_statistics() {
+  memset(&_statistics, 0, sizeof(struct precise_sntp_statistics));
+  memset(_statistics_samples, 0, sizeof(_statistics_samples));
+  _statistics_offset_sum = 0;
+  _statistics_delay_sum = 0;
+  _statistics_next_sample = 0;
+}
+#endif
+
+/*
+  returns the local clock from the published clock state,
+  with monotonic never less than the clock before a step back
+*/
+uint64_t precise_sntp::read_local_clock(bool monotonic) {
+  // the published copy of the clock state never tears, even if this is
+  // called in an interrupt or on another core while the clock is updated
+  struct precise_sntp_clock_state c;
+  precise_sntp_latch_read(&_clock_sequence, _clock_latch, &c,
+			  sizeof(struct precise_sntp_clock_state));
+  const unsigned long ticks = PRECISE_SNTP_TICKS();
+  // an overflow not yet noticed by check_millis_overflow()
+  const uint16_t overflow_count =
+    c.ticks_overflow_count + ((ticks < c.last_overflow_check) ? 1 : 0);
+  const uint64_t clock =
+    clock_state2clock(&c, (((uint64_t) overflow_count) << 32) + ticks);
+  if (monotonic && (clock < c.monotonic_floor)) {
+    return c.monotonic_floor;
+  }
+  return clock;
 }
 
 struct ntp_timestamp_format_struct precise_sntp::get_local_clock() {
-  const uint64_t mtime = (((uint64_t) _millis_overflow_count) << 32) + millis();
-  uint64_t my_local_clock;
-  my_local_clock =
-    (int64_t) _ntp_local_clock_union2uint64(_ntp_local_clock) +
-    ((((mtime - _last_clock_update) << 16) / 1000) << 16);
+  const uint64_t my_local_clock = read_local_clock(false);
+  struct ntp_timestamp_format_struct now;
+  now.seconds = (uint32_t) (my_local_clock >> 32);
+  now.fraction = (uint32_t) (my_local_clock & 0x00000000FFFFFFFFULL);
+  return now;
+}
+
+struct ntp_timestamp_format_struct precise_sntp::get_monotonic_clock() {
+  const uint64_t my_local_clock = read_local_clock(true);
   struct ntp_timestamp_format_struct now;
   now.seconds = (uint32_t) (my_local_clock >> 32);
   now.fraction = (uint32_t) (my_local_clock & 0x00000000FFFFFFFFULL);
   return now;
 }
 
+/*
+  Takes a snapshot of the published clock state for the batch conversion
+  of ticks (see precise_sntp_convert_ticks.h).
+*/
+void precise_sntp::convert_ticks_parameter(
+  struct precise_sntp_convert_ticks_parameter *parameter) {
+  struct precise_sntp_clock_state c;
+  precise_sntp_latch_read(&_clock_sequence, _clock_latch, &c,
+			  sizeof(struct precise_sntp_clock_state));
+  const unsigned long ticks = PRECISE_SNTP_TICKS();
+  // an overflow not yet noticed by check_millis_overflow()
+  const uint16_t overflow_count =
+    c.ticks_overflow_count + ((ticks < c.last_overflow_check) ? 1 : 0);
+  parameter->now_ticks = ticks;
+  parameter->elapsed = (int64_t)
+    precise_sntp_ticks2duration((((uint64_t) overflow_count) << 32) + ticks -
+				c.last_clock_update,
+				NTP_DURATION_PER_TICK_INT,
+				NTP_DURATION_PER_TICK_FRAC);
+  parameter->clock = _ntp_local_clock_union2uint64(c.clock);
+  parameter->frequency = c.frequency;
+  parameter->slew_rate = c.slew_rate;
+  parameter->slew = c.slew;
+  parameter->per_tick_int = NTP_DURATION_PER_TICK_INT;
+  parameter->per_tick_frac = NTP_DURATION_PER_TICK_FRAC;
+}
+
+void precise_sntp::convert_ticks(const unsigned long *ticks,
+				 struct ntp_timestamp_format_struct *clock,
+				 size_t n) {
+  struct precise_sntp_convert_ticks_parameter parameter;
+  convert_ticks_parameter(&parameter);
+  precise_sntp_convert_ticks(&parameter, ticks, clock, n);
+}
+
+void precise_sntp::convert_ticks_epoch(const unsigned long *ticks,
+				       struct timestamp_format *epoch,
+				       size_t n) {
+  struct precise_sntp_convert_ticks_parameter parameter;
+  convert_ticks_parameter(&parameter);
+  precise_sntp_convert_ticks_epoch(&parameter, ticks, epoch, n);
+}
+
+/*
+  returns the local clock at ticks as it was at that time, now are the
+  continuous ticks of the history (see anchor_clock()) and ticks is at
+  most 2^32 ticks before now
+*/
+uint64_t precise_sntp::past_ticks2clock(uint64_t now, unsigned long ticks) {
+  const uint64_t t = now - (uint32_t) (((unsigned long) now) - ticks);
+  return clock_segment2clock(precise_sntp_clock_history_find(&_history, t), t);
+}
+
+void precise_sntp::convert_past_ticks(const unsigned long *ticks,
+				      struct ntp_timestamp_format_struct *clock,
+				      size_t n) {
+  if (_history.count == 0) {
+    // the clock was never set
+    convert_ticks(ticks, clock, n);
+    return;
+  }
+  const uint64_t now = _history_base + get_ticks();
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t c = past_ticks2clock(now, ticks[i]);
+    clock[i].seconds = (uint32_t) (c >> 32);
+    clock[i].fraction = (uint32_t) c;
+  }
+}
+
+void precise_sntp::convert_past_ticks_epoch(const unsigned long *ticks,
+					    struct timestamp_format *epoch,
+					    size_t n) {
+  if (_history.count == 0) {
+    convert_ticks_epoch(ticks, epoch, n);
+    return;
+  }
+  const uint64_t now = _history_base + get_ticks();
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t c = past_ticks2clock(now, ticks[i]);
+    epoch[i].seconds = (uint32_t) (c >> 32) - 2208988800UL;
+    epoch[i].fraction = (uint32_t) c;
+  }
+}
+
+uint64_t precise_sntp::get_ticks() {
+  check_millis_overflow();
+  return (((uint64_t) _clock.ticks_overflow_count) << 32) +
+    _clock.last_overflow_check;
+}
+
+/*
+  returns the local clock at the extended ticks including the correction
+  not slewed yet, so the offsets of new samples do not count it twice
+*/
+uint64_t precise_sntp::ticks2clock(uint64_t ticks) {
+  return clock_state2clock(&_clock, ticks, true);
+}
+
+void precise_sntp::set_local_clock(uint64_t clock) {
+  anchor_clock(clock, get_ticks(), 0);
+}
+
+/*
+  Sets the local clock to clock at the extended ticks (get_ticks()) and
+  slews the correction slew from then on.
+*/
+void precise_sntp::anchor_clock(uint64_t clock, uint64_t ticks, int64_t slew) {
+  if (_clock_set) {
+    // get_monotonic_clock() does not go back behind the clock until now
+    const uint64_t now = clock_state2clock(&_clock, get_ticks());
+    if (now > _clock.monotonic_floor) {
+      _clock.monotonic_floor = now;
+    }
+  }
+  _clock.clock.as_timestamp.seconds = (uint32_t) (clock >> 32);
+  _clock.clock.as_timestamp.fraction =
+    (uint32_t) (clock & 0x00000000FFFFFFFFULL);
+  _clock.last_clock_update = (unsigned long) ticks;
+  _clock.ticks_overflow_count = 0;
+  _clock.last_overflow_check = _clock.last_clock_update;
+  _clock.slew = slew;
+  _clock_set = true;
+  // the extended ticks start again at the last clock update,
+  // the ticks of the history continue
+  _history_base += ticks - _clock.last_clock_update;
+  struct precise_sntp_clock_segment *segment =
+    precise_sntp_clock_history_add(&_history);
+  segment->ticks = _history_base + _clock.last_clock_update;
+  segment->clock = clock;
+  segment->slew = slew;
+  publish_clock();
+}
+
+void precise_sntp::set_slew_rate(uint16_t ppm) {
+  if (ppm > 500) {
+    ppm = 500;
+  }
+  if (_clock_set) {
+    // keep the pending correction, without slewing it is applied now
+    const uint64_t ticks = get_ticks();
+    const uint64_t target = ticks2clock(ticks);
+    if (ppm == 0) {
+      anchor_clock(target, ticks, 0);
+    } else {
+      const uint64_t now = clock_state2clock(&_clock, ticks);
+      anchor_clock(now, ticks, (int64_t) (target - now));
+    }
+  }
+  _clock.slew_rate = ((uint32_t) ppm) * 4295UL; // 2^32 / 10^6 = 4295
+  publish_clock();
+}
+
+/*
+  Publishes the clock state _clock to the readers of get_local_clock().
+*/
+void precise_sntp::publish_clock() {
+  // the frequency and the slew rate are set after the clock update
+  struct precise_sntp_clock_segment *segment =
+    precise_sntp_clock_history_newest(&_history);
+  if (segment) {
+    segment->frequency = _clock.frequency;
+    segment->slew_rate = _clock.slew_rate;
+  }
+  precise_sntp_latch_write(&_clock_sequence, _clock_latch, &_clock,
+			   sizeof(struct precise_sntp_clock_state));
+}
+
+void precise_sntp::discipline_frequency(int64_t offset, unsigned long mu) {
+  // Only use intervals long enough to not amplify the noise of the offsets.
+  if (mu < 1000 * (1 << NTP_MIN_POLL_EXPONENT)) {
+    return;
+  }
+  // The offset accumulated in the interval mu (in milliseconds) is the
+  // frequency error: offset / mu in units of 2^-32.
+  // This is the frequency-lock loop of RFC 5905 section 11.3.
+  int64_t frequency = _clock.frequency + ((offset * 1000 / (int64_t) mu) >>
+				    NTP_FLL_GAIN_SHIFT);
+  if (frequency > NTP_MAXFREQ) {
+    frequency = NTP_MAXFREQ;
+  } else if (frequency < -NTP_MAXFREQ) {
+    frequency = -NTP_MAXFREQ;
+  }
+  // wander: mean absolute change of the frequency (exponential average)
+  const int64_t change = frequency - _clock.frequency;
+  _wander = (uint32_t) ((3 * ((int64_t) _wander) +
+			 ((change < 0) ? -change : change)) / 4);
+  _clock.frequency = (int32_t) frequency;
+  publish_clock();
+#ifdef PRECISE_SNTP_DEBUG
+  Serial.print("frequency [ppb]: ");
+  Serial.println((int32_t) ((((int64_t) _clock.frequency) * 1000000000) >> 32));
+#endif
+}
+
 time_t precise_sntp::get_epoch() {
   const struct ntp_timestamp_format_struct now = get_local_clock();
   return ntp_timestamp_seconds2epoch(now);
@@ -379,7 +1892,222 @@ unsigned long precise_sntp::get_last_update() {
   return _last_update;
 }
 
+int64_t precise_sntp::get_offset() {
+  return _associations[_system_peer].filter.offset;
+}
+
+uint64_t precise_sntp::get_delay() {
+  return _associations[_system_peer].filter.delay;
+}
+
+uint64_t precise_sntp::get_jitter() {
+  return _associations[_system_peer].filter.jitter;
+}
+
+uint64_t precise_sntp::get_sync_distance() {
+  return root_distance(&(_associations[_system_peer]), millis());
+}
+
+uint8_t precise_sntp::get_leap_indicator() {
+  return _associations[_system_peer].leap;
+}
+
+void precise_sntp::set_max_distance(uint16_t milliseconds) {
+  _max_distance = milliseconds;
+}
+
+uint8_t precise_sntp::get_stratum() {
+  return _associations[_system_peer].stratum;
+}
+
+uint64_t precise_sntp::get_root_delay() {
+  const struct precise_sntp_association *a = &(_associations[_system_peer]);
+  return (((uint64_t) a->rootdelay) << 16) + a->filter.delay;
+}
+
+uint32_t precise_sntp::get_reference_id() {
+  const IPAddress ip = _associations[_system_peer].ip;
+  return (((uint32_t) ip[0]) << 24) | (((uint32_t) ip[1]) << 16) |
+    (((uint32_t) ip[2]) << 8) | ((uint32_t) ip[3]);
+}
+
+int8_t precise_sntp::get_precision() {
+  return NTP_LOCAL_PRECISION_EXPONENT;
+}
+
+void precise_sntp::set_receive_timestamp_hook(
+  bool (*hook)(unsigned long *ticks)) {
+  _receive_timestamp_hook = hook;
+}
+
+/*
+  stores v little-endian at p
+*/
+static void state_put32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t) v;
+  p[1] = (uint8_t) (v >> 8);
+  p[2] = (uint8_t) (v >> 16);
+  p[3] = (uint8_t) (v >> 24);
+}
+
+/*
+  returns the little-endian value at p
+*/
+static uint32_t state_get32(const uint8_t *p) {
+  return ((uint32_t) p[0]) | (((uint32_t) p[1]) << 8) |
+    (((uint32_t) p[2]) << 16) | (((uint32_t) p[3]) << 24);
+}
+
+/*
+  Layout of the state (PRECISE_SNTP_STATE_SIZE bytes, little-endian):
+
+  0: 'P', 'S' (magic)
+  2: version (PRECISE_SNTP_STATE_VERSION)
+  3: size (PRECISE_SNTP_STATE_SIZE)
+  4: frequency correction (int32_t, 2^-32)
+  8: wander (uint32_t, 2^-32)
+  12: poll exponent
+  13: hysteresis counter of the poll-adjust (int8_t)
+  14: index of the system peer
+  15: flags: bit 0 the clock was synchronized
+  16: address of the system peer
+  20: CRC-16 of the bytes 0 to 19
+*/
+size_t precise_sntp::export_state(uint8_t *buffer, size_t size) {
+  if (size < PRECISE_SNTP_STATE_SIZE) {
+    return 0;
+  }
+  const IPAddress ip = _associations[_system_peer].ip;
+  buffer[0] = 'P';
+  buffer[1] = 'S';
+  buffer[2] = PRECISE_SNTP_STATE_VERSION;
+  buffer[3] = PRECISE_SNTP_STATE_SIZE;
+  state_put32(buffer + 4, (uint32_t) _clock.frequency);
+  state_put32(buffer + 8, _wander);
+  buffer[12] = _poll_exponent;
+  buffer[13] = (uint8_t) _poll_counter;
+  buffer[14] = _system_peer;
+  buffer[15] = is_synchronized() ? 1 : 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    buffer[16 + i] = ip[i];
+  }
+  const uint16_t crc = precise_sntp_crc16(buffer, PRECISE_SNTP_STATE_SIZE - 2);
+  buffer[PRECISE_SNTP_STATE_SIZE - 2] = (uint8_t) crc;
+  buffer[PRECISE_SNTP_STATE_SIZE - 1] = (uint8_t) (crc >> 8);
+  return PRECISE_SNTP_STATE_SIZE;
+}
+
+bool precise_sntp::import_state(const uint8_t *buffer, size_t size) {
+  if ((size < PRECISE_SNTP_STATE_SIZE) || (buffer[0] != 'P') ||
+      (buffer[1] != 'S') || (buffer[2] != PRECISE_SNTP_STATE_VERSION) ||
+      (buffer[3] != PRECISE_SNTP_STATE_SIZE)) {
+    return false;
+  }
+  const uint16_t crc = precise_sntp_crc16(buffer, PRECISE_SNTP_STATE_SIZE - 2);
+  if ((buffer[PRECISE_SNTP_STATE_SIZE - 2] != (uint8_t) crc) ||
+      (buffer[PRECISE_SNTP_STATE_SIZE - 1] != (uint8_t) (crc >> 8))) {
+    return false;
+  }
+  int32_t frequency = (int32_t) state_get32(buffer + 4);
+  if (frequency > NTP_MAXFREQ) {
+    frequency = NTP_MAXFREQ;
+  } else if (frequency < -NTP_MAXFREQ) {
+    frequency = -NTP_MAXFREQ;
+  }
+  if (_clock_set) {
+    // re-anchor the clock (keeping the pending slew), so the new frequency
+    // is only used from now on and the history of the past stays valid
+    const uint64_t ticks = get_ticks();
+    const uint64_t now = clock_state2clock(&_clock, ticks);
+    anchor_clock(now, ticks, (int64_t) (ticks2clock(ticks) - now));
+  }
+  _clock.frequency = frequency;
+  publish_clock();
+  _wander = state_get32(buffer + 8);
+  // the range could have been changed by set_poll_exponent_range()
+  _poll_exponent = clamp_poll_exponent(buffer[12]);
+  _poll_counter = (int8_t) buffer[13];
+  _warm_start = (buffer[15] & 1) != 0;
+  const uint8_t peer = buffer[14];
+  if (peer < _number_of_associations) {
+    struct precise_sntp_association *a = &(_associations[peer]);
+    const IPAddress ip(buffer[16], buffer[17], buffer[18], buffer[19]);
+    if (a->name && _resolver) {
+      // keep the last good server of the name until the resolve lifetime
+      a->ip = ip;
+      a->resolved = true;
+      a->resolved_time = millis();
+      _system_peer = peer;
+    } else if ((!a->name) && (a->ip == ip)) {
+      _system_peer = peer;
+    }
+  }
+  return true;
+}
+
+bool precise_sntp::save_state(precise_sntp_storage &storage) {
+  uint8_t buffer[PRECISE_SNTP_STATE_SIZE];
+  return (export_state(buffer, PRECISE_SNTP_STATE_SIZE) ==
+	  PRECISE_SNTP_STATE_SIZE) &&
+    storage.write(buffer, PRECISE_SNTP_STATE_SIZE);
+}
+
+bool precise_sntp::load_state(precise_sntp_storage &storage) {
+  uint8_t buffer[PRECISE_SNTP_STATE_SIZE];
+  return storage.read(buffer, PRECISE_SNTP_STATE_SIZE) &&
+    import_state(buffer, PRECISE_SNTP_STATE_SIZE);
+}
+
+int32_t precise_sntp::get_frequency() {
+  return _clock.frequency;
+}
+
 bool precise_sntp::is_synchronized() {
+  if (_max_error > 0) {
+    return error_bound(millis()) <= NTP_MILLIS2DURATION(_max_error);
+  }
   return (_is_synced &&
-	  (_last_update > millis() - 1000 * (1 << _poll_exponent)));
+	  (millis() - _last_update < 1000UL * (1UL << _poll_exponent)));
+}
+
+/*
+  returns the maximal error of the local clock in units of 2^-32 seconds
+  (see tget_epoch_with_error())
+*/
+uint64_t precise_sntp::error_bound(unsigned long now) {
+  if (!_clock_set) {
+    return 0xFFFFFFFFFFFFFFFFULL;
+  }
+  const struct precise_sntp_association *a = &(_associations[_system_peer]);
+  const struct precise_sntp_clock_filter *f = &(a->filter);
+  if (f->count == 0) {
+    // only set by a transmit timestamp or stepped
+    return NTP_MAXDISP;
+  }
+  const uint8_t newest = (f->next + PRECISE_SNTP_FILTER_STAGES - 1) %
+    PRECISE_SNTP_FILTER_STAGES;
+  const uint64_t age = NTP_MILLIS2DURATION(now - f->samples[newest].time);
+  // the root distance grows by the frequency tolerance, the learned
+  // frequency can be wrong by its wander
+  uint64_t error = root_distance(a, now) + (((age >> 16) * _wander) >> 16);
+  // the correction not slewed yet
+  const uint64_t ticks = get_ticks();
+  const int64_t pending =
+    (int64_t) (ticks2clock(ticks) - clock_state2clock(&_clock, ticks));
+  error += (pending < 0) ? -pending : pending;
+  return error;
+}
+
+timestamp_with_error_format precise_sntp::tget_epoch_with_error() {
+  const uint64_t error = error_bound(millis());
+  const struct ntp_timestamp_format_struct ntp_now = get_local_clock();
+  struct timestamp_with_error_format now;
+  now.seconds = ntp_timestamp_seconds2epoch(ntp_now);
+  now.fraction = ntp_now.fraction;
+  now.error = error;
+  return now;
+}
+
+void precise_sntp::set_max_error(unsigned long milliseconds) {
+  _max_error = milliseconds;
 }
@@ -1,6 +1,6 @@
 /*
   Author: Daniel Mohr
-  Date: 2022-12-15
+  Date: 2026-10-17
 
   For more information look at the README.md.
 */
@@ -10,9 +10,63 @@
 #include <Arduino.h>
 #include <Udp.h>
 
+#include <precise_sntp_clock_history.h>
+
 // if PRECISE_SNTP_DEBUG exists debugging output to serial console is done
 // #define PRECISE_SNTP_DEBUG
 
+// if PRECISE_SNTP_STATISTICS exists statistics are collected
+// (see get_statistics()), otherwise they cost neither memory nor time
+// #define PRECISE_SNTP_STATISTICS
+
+// if PRECISE_SNTP_USE_MICROS exists the local clock is based on micros()
+// instead of millis(), which gives sub-millisecond resolution
+// #define PRECISE_SNTP_USE_MICROS
+
+// By default any UDP driver is used via the virtual methods of UDP. If
+// PRECISE_SNTP_UDP_TYPE is defined (e. g. EthernetUDP), only this driver
+// is accepted and its methods are called directly (no virtual dispatch),
+// so the compiler can inline them; PRECISE_SNTP_UDP_INCLUDE is the header
+// declaring it (e. g. <EthernetUdp.h>). Both have to be given as build
+// flags, since they are needed to compile precise_sntp.cpp.
+// #define PRECISE_SNTP_UDP_TYPE EthernetUDP
+// #define PRECISE_SNTP_UDP_INCLUDE <EthernetUdp.h>
+
+#ifdef PRECISE_SNTP_UDP_TYPE
+#ifndef PRECISE_SNTP_UDP_INCLUDE
+#error "PRECISE_SNTP_UDP_TYPE needs PRECISE_SNTP_UDP_INCLUDE"
+#endif
+class PRECISE_SNTP_UDP_TYPE;
+#else
+#define PRECISE_SNTP_UDP_TYPE UDP
+#endif
+
+// local port of the requests
+#ifndef PRECISE_SNTP_LOCAL_PORT
+#define PRECISE_SNTP_LOCAL_PORT 1234
+#endif
+
+// port of the ntp servers
+#ifndef PRECISE_SNTP_SERVER_PORT
+#define PRECISE_SNTP_SERVER_PORT 123
+#endif
+
+// maximal time to wait for an answer in milliseconds
+#ifndef PRECISE_SNTP_REPLY_TIMEOUT
+#define PRECISE_SNTP_REPLY_TIMEOUT 1000
+#endif
+
+// upper limit of set_start_delay() in milliseconds (3 hours)
+#define PRECISE_SNTP_MAX_START_DELAY 10800000UL
+
+#ifdef PRECISE_SNTP_USE_MICROS
+#define PRECISE_SNTP_TICKS() micros()
+#define PRECISE_SNTP_TICKS_PER_SECOND 1000000UL
+#else
+#define PRECISE_SNTP_TICKS() millis()
+#define PRECISE_SNTP_TICKS_PER_SECOND 1000UL
+#endif
+
 struct ntp_timestamp_format_struct { // 8 bytes
   uint32_t seconds;
   uint32_t fraction;
@@ -23,11 +77,200 @@ struct timestamp_format { // 8 bytes
   uint32_t fraction;
 };
 
+struct timestamp_with_error_format { // 16 bytes
+  uint32_t seconds;
+  uint32_t fraction;
+  uint64_t error; // maximal error (+-) in units of 2^-32 seconds
+};
+
 union ntp_local_clock_union {
   byte as_bytes[8];
   struct ntp_timestamp_format_struct as_timestamp;
 };
 
+/*
+  State of the local clock: the clock was set to clock at the ticks
+  last_clock_update and runs with the frequency correction since then.
+  The correction slew is applied with at most slew_rate since then.
+*/
+struct precise_sntp_clock_state {
+  union ntp_local_clock_union clock;
+  unsigned long last_clock_update; // ticks of the last clock update
+  uint16_t ticks_overflow_count;
+  unsigned long last_overflow_check;
+  int32_t frequency; // frequency correction in units of 2^-32
+  uint32_t slew_rate; // maximal slew rate in units of 2^-32 (0: step)
+  int64_t slew; // correction to slew in units of 2^-32 seconds
+  uint64_t monotonic_floor; // clock before the last step (2^-32 seconds)
+};
+
+// version and size of the state of export_state()
+#define PRECISE_SNTP_STATE_VERSION 1
+#define PRECISE_SNTP_STATE_SIZE 22
+
+// number of stages of the clock filter (RFC 5905 uses 8)
+#define PRECISE_SNTP_FILTER_STAGES 8
+
+/*
+  One sample of the clock filter.
+
+  All durations are in units of 2^-32 seconds (ntp timestamp format).
+*/
+struct precise_sntp_filter_sample {
+  int64_t offset; // offset theta of the server relative to the local clock
+  uint64_t delay; // round-trip delay delta
+  uint64_t dispersion; // dispersion epsilon at the time of the sample
+  unsigned long time; // millis() at the time of the sample
+};
+
+/*
+  Clock filter (RFC 5905 section 10): a shift register of the last samples.
+  The sample with the lowest delay is selected.
+*/
+struct precise_sntp_clock_filter {
+  struct precise_sntp_filter_sample samples[PRECISE_SNTP_FILTER_STAGES];
+  uint8_t next; // index of the stage for the next sample
+  uint8_t count; // number of valid samples
+  bool used; // true if last_used is valid
+  unsigned long last_used; // time of the last sample used to adjust the clock
+  int64_t offset; // offset of the selected sample
+  uint64_t delay; // delay of the selected sample
+  uint64_t dispersion; // filter dispersion
+  uint64_t jitter; // filter jitter
+};
+
+#ifdef PRECISE_SNTP_STATISTICS
+// number of buckets of the histograms of the statistics
+#define PRECISE_SNTP_STATISTICS_BUCKETS 20
+// number of the last samples kept by the statistics
+#ifndef PRECISE_SNTP_STATISTICS_SAMPLES
+#define PRECISE_SNTP_STATISTICS_SAMPLES 8
+#endif
+// offset_mean and delay_mean use the samples clamped to this (256 seconds)
+#define PRECISE_SNTP_STATISTICS_MEAN_LIMIT (((int64_t) 1) << 40)
+
+/*
+  One raw sample of the statistics (before the clock filter).
+*/
+struct precise_sntp_statistics_sample {
+  unsigned long time; // millis() at the time of the sample
+  uint8_t server; // index of the server (see get_system_peer())
+  int64_t offset; // offset theta in units of 2^-32 seconds
+  uint64_t delay; // round-trip delay delta in units of 2^-32 seconds
+  uint64_t dispersion; // dispersion epsilon in units of 2^-32 seconds
+};
+
+/*
+  Snapshot of the statistics (see get_statistics()).
+
+  All offsets and delays are in units of 2^-32 seconds. For offset_mean
+  and delay_mean each sample is clamped to
+  +-PRECISE_SNTP_STATISTICS_MEAN_LIMIT, so a falseticker does not overflow
+  the sums.
+
+  Bucket 0 of a histogram counts the absolute values below 2^-20 seconds
+  (about 1 us). Bucket i counts the absolute values from 2^(i-21) to
+  2^(i-20) seconds. The last bucket counts all values from 2^-2 seconds.
+*/
+struct precise_sntp_statistics {
+  uint32_t results[13]; // finished polls by error code, 1: skipped polls
+  uint32_t requests; // requests sent to the servers
+  uint32_t samples; // samples fed into the clock filters
+  int64_t offset_min;
+  int64_t offset_mean;
+  int64_t offset_max;
+  uint64_t delay_min;
+  uint64_t delay_mean;
+  uint64_t delay_max;
+  uint32_t offset_histogram[PRECISE_SNTP_STATISTICS_BUCKETS];
+  uint32_t delay_histogram[PRECISE_SNTP_STATISTICS_BUCKETS];
+  unsigned long poll_duration; // microseconds from start to end of last poll
+  unsigned long poll_duration_max; // microseconds
+  unsigned long service_time; // microseconds in service() for the last poll
+  unsigned long service_time_max; // microseconds
+  uint8_t poll_exponent; // actual poll exponent
+  uint8_t number_of_samples; // valid entries in last_samples
+  // the last samples, the newest first
+  struct precise_sntp_statistics_sample
+  last_samples[PRECISE_SNTP_STATISTICS_SAMPLES];
+};
+#endif
+
+// maximal number of time servers (associations), each needs about 300 bytes
+#ifndef PRECISE_SNTP_MAX_SERVERS
+#define PRECISE_SNTP_MAX_SERVERS 4
+#endif
+
+/*
+  One association: a time server with its own clock filter and poll state.
+*/
+struct precise_sntp_association {
+  IPAddress ip; // address of the server, used if name is NULL
+  const char* name; // name of the server or NULL
+  struct precise_sntp_clock_filter filter;
+  uint8_t reach; // reachability register, bit 0 is the last poll
+  uint8_t result; // error code of the last poll of this server
+  uint8_t poll; // poll exponent announced by the server
+  bool new_sample; // the filter selected a sample not used before
+  bool resolved; // ip is the cached address of name
+  unsigned long resolved_time; // millis() of the name resolution
+  uint8_t failures; // successive polls without answer (error 3 or 6)
+  bool denied; // the server sent the kiss code DENY or RSTR
+  uint8_t stratum; // stratum of the last answer
+  uint8_t leap; // leap indicator of the last answer
+  uint32_t rootdelay; // root delay of the last answer (ntp short format)
+  uint32_t rootdisp; // root dispersion of the last answer (ntp short format)
+  uint64_t broadcast_delay; // calibrated round-trip delay (broadcast mode)
+};
+
+/*
+  States of the asynchronous poll engine (see begin_poll() and service()).
+*/
+enum precise_sntp_poll_state : uint8_t {
+  PRECISE_SNTP_POLL_IDLE, // no poll is running
+  PRECISE_SNTP_POLL_SEND, // request has to be sent to the server
+  PRECISE_SNTP_POLL_AWAIT_REPLY, // waiting for the answer of the server
+  PRECISE_SNTP_POLL_VALIDATE, // answer has to be read and checked
+  PRECISE_SNTP_POLL_FILTER, // answer has to be fed into the clock filter
+  PRECISE_SNTP_POLL_APPLY, // selected servers have to correct the local clock
+  PRECISE_SNTP_POLL_IBURST // pipelined requests of begin_iburst() are running
+};
+
+// maximal number of requests of begin_iburst() waiting for an answer
+#ifndef PRECISE_SNTP_IBURST_SLOTS
+#define PRECISE_SNTP_IBURST_SLOTS 4
+#endif
+
+/*
+  Progress of an asynchronous iburst (see begin_iburst()).
+*/
+struct precise_sntp_iburst_status {
+  bool running; // requests are sent or answers are awaited
+  uint8_t requests; // number of requests to send
+  uint8_t sent; // requests sent
+  uint8_t valid; // valid answers fed into the clock filters
+  uint8_t failed; // requests without a valid answer
+  uint8_t last_error; // error code of the last failed request
+  uint8_t result; // error code of the finished iburst (like service())
+};
+
+/*
+  One request of an iburst waiting for an answer.
+*/
+struct precise_sntp_iburst_slot {
+  bool used;
+  uint8_t association; // index of the server
+  struct ntp_timestamp_format_struct xmt; // opaque transmit timestamp
+  unsigned long t1; // ticks (millis() or micros()) when it was sent
+  unsigned long sent; // millis() when it was sent
+};
+
+struct precise_sntp_convert_ticks_parameter;
+class precise_sntp_storage;
+
+// returned by service() and update_async() as long as a poll is running
+#define PRECISE_SNTP_POLL_PENDING 255
+
 class precise_sntp {
  public:
 
@@ -47,7 +290,7 @@ class precise_sntp {
     sntp.update();
     }
   */
-  precise_sntp(UDP &udp);
+  precise_sntp(PRECISE_SNTP_UDP_TYPE &udp);
 
   /*
     initialization of the class with a specific time server
@@ -64,7 +307,7 @@ class precise_sntp {
     sntp.update();
     }
   */
-  precise_sntp(UDP &udp, IPAddress ntp_server_ip);
+  precise_sntp(PRECISE_SNTP_UDP_TYPE &udp, IPAddress ntp_server_ip);
 
   /*
     initialization of the class with a specific time server name
@@ -80,7 +323,7 @@ class precise_sntp {
     sntp.update();
     }
   */
-  precise_sntp(UDP &udp, const char* ntp_server_name);
+  precise_sntp(PRECISE_SNTP_UDP_TYPE &udp, const char* ntp_server_name);
 
   /*
     Set the used poll exponent range.
@@ -98,20 +341,167 @@ class precise_sntp {
   void set_poll_exponent_range(uint8_t min_poll, uint8_t max_poll);
 
   /*
-    This checks if millis overflow.
+    Returns the actual poll exponent: the next poll of update() and
+    update_adapt_poll_period() is done 2^poll_exponent seconds after the
+    last successful one.
+  */
+  uint8_t get_poll_exponent();
+
+  /*
+    Set the seed of the pseudo random numbers used for the transmit
+    timestamps and the scheduling of the polls (see set_start_delay(),
+    set_poll_jitter()). A seed of 0 is ignored.
+
+    Many devices started at the same time would use the same seed.
+    Therefore a seed unique for each device (e. g. from the MAC address or
+    a serial number) should be set. Anyhow the seeds diverge with the
+    receive timestamps of the answers of the server.
+
+    Example:
+
+    byte mac[6];
+    WiFi.macAddress(mac);
+    sntp.set_random_seed((((uint32_t) mac[2]) << 24) |
+                         (((uint32_t) mac[3]) << 16) |
+                         (((uint32_t) mac[4]) << 8) | mac[5]);
+  */
+  void set_random_seed(uint32_t seed);
+
+  /*
+    Set the maximal delay in milliseconds of the first poll of update(),
+    update_adapt_poll_period() or update_async(). The delay is chosen
+    randomly from 0 to max_delay. So many devices powered on at the same
+    time do not ask the server at the same moment. Default is 0.
+    Larger values than PRECISE_SNTP_MAX_START_DELAY (3 hours) are limited
+    to it.
+  */
+  void set_start_delay(unsigned long max_delay);
+
+  /*
+    Set the jitter of the poll period in percent (at most 50).
+    After each successful poll the poll period is shortened randomly by up
+    to this percentage. So many devices do not stay in lockstep.
+    Default is 0.
+  */
+  void set_poll_jitter(uint8_t percent);
+
+  /*
+    Adds a further time server (association).
 
-    This method is called from update() and update_adapt_poll_period().
-    Therefore it is not necessary to call this function in addition.
+    Each poll asks all servers one after the other. Each server has its own
+    clock filter. The servers are compared by the selection and cluster
+    algorithms of RFC 5905: Servers (falsetickers) whose offset is not in
+    the intersection of the correctness intervals of the majority are
+    discarded. The offsets of the remaining servers (truechimers) are
+    averaged weighted by their root distance to correct the local clock.
+    Therefore, at least 3 servers are needed to detect one falseticker.
+
+    Adding the same name several times, e. g. "pool.ntp.org", gives
+    different servers, if the name resolution rotates the addresses.
+
+    At most PRECISE_SNTP_MAX_SERVERS servers (including the one given
+    in the constructor) are possible. No heap is used.
+
+    returns false if no further server can be added
+
+    Example:
+
+    #include <EthernetUdp.h>
+    #include <IPAddress.h>
+    #include <precise_sntp.h>
+    EthernetUDP udp;
+    precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+    void setup() {
+      sntp.add_server(IPAddress(192, 168, 178, 2));
+      sntp.add_server("pool.ntp.org");
+    }
+    void loop() {
+      sntp.update();
+    }
+  */
+  bool add_server(IPAddress ntp_server_ip);
+  bool add_server(const char* ntp_server_name);
+
+  /*
+    Sets a function to resolve the names of the time servers.
+
+    Without it the name is given to the UDP driver (beginPacket()) in each
+    poll, which usually resolves the name each time. With it the resolved
+    address is cached for set_resolve_lifetime() seconds. The name is
+    resolved again after this lifetime or after 3 successive polls without
+    an answer (error code 3 or 6). If the resolution fails, the cached
+    address is further used. The resolver should return 1 on success like
+    hostByName() of the WiFi libraries or getHostByName() of DNSClient.
+
+    If the same name is added several times (see add_server()), the
+    resolver is asked again (up to PRECISE_SNTP_MAX_SERVERS times) until it
+    gives an address not used by the other servers with this name. A pool
+    name with rotating answers gives this way different members.
+
+    Use NULL to remove the resolver.
+
+    Example:
+
+    #include <WiFiNINA.h>
+    #include <precise_sntp.h>
+    WiFiUDP udp;
+    precise_sntp sntp(udp, "pool.ntp.org");
+    int resolver(const char* name, IPAddress &ip) {
+      return WiFi.hostByName(name, ip);
+    }
+    void setup() {
+      sntp.set_resolver(resolver);
+    }
+  */
+  void set_resolver(int (*resolver)(const char* name, IPAddress &ip));
+
+  /*
+    Sets the time in seconds a resolved address is used (default: 3600).
+    At most 4294967 seconds (about 49 days) are possible.
+  */
+  void set_resolve_lifetime(unsigned long seconds);
+
+  /*
+    Returns the number of time servers (associations).
+  */
+  uint8_t get_number_of_servers();
+
+  /*
+    Returns the number of servers which survived the selection and
+    cluster algorithms in the last poll.
+  */
+  uint8_t get_number_of_survivors();
+
+  /*
+    Returns the index of the system peer, the best of the surviving servers
+    (0 is the server given in the constructor, 1 the first added and so on).
+  */
+  uint8_t get_system_peer();
+
+  /*
+    This checks if millis overflow (or micros if PRECISE_SNTP_USE_MICROS
+    is defined).
+
+    This method is called from update(), update_adapt_poll_period() and
+    update_async(). Therefore it is not necessary to call this function
+    in addition.
 
     The returned epoch in other methods is always calculated using millis().
     millis() will overflow after about 50 days and the returned epoch is not
     correct anymore. To handle this, check_millis_overflow() tries to count
     the overflows of millis().
 
-    If you do not call update() or update_adapt_poll_period() at least every
-    24 days, you should call check_millis_overflow() at least every 24 days.
+    If you do not call update(), update_adapt_poll_period() or update_async()
+    at least every 24 days, you should call check_millis_overflow() at least
+    every 24 days.
 
     This should work for about 8926 years, then the check counter will overflow.
+
+    If PRECISE_SNTP_USE_MICROS is defined, the local clock is based on
+    micros(), which overflows after about 71 minutes. Then this has to be
+    called at least every 35 minutes. Again update(),
+    update_adapt_poll_period() or update_async() do this, if called
+    regularly (e. g. in every loop()).
   */
   void check_millis_overflow();
 
@@ -122,17 +512,27 @@ class precise_sntp {
     The smallest allowed poll exponent is used. This means as often
     as allowed we get the time from the server.
 
+    After an unsuccessful poll (error codes 3 to 9) the next poll waits
+    1 s, after further unsuccessful polls 2 s, 4 s, ... up to the minimal
+    poll period (each time multiplied by a random factor from 0.5 to 1).
+    Not synchronized servers (error code 8) give directly the minimal poll
+    period.
+
     returns an error code:
 
     0: success
     1: poll policy does not allow fast updates, skip communication with server
-    2: cannot use local port _localport
+    2: cannot use local port PRECISE_SNTP_LOCAL_PORT
     3: cannot start connection
     4: problems writing data
     5: packet was not send
     6: got no answer from server
     7: sanity check fail, answer from server is bogus
     8: sanity check fail, server is not synchronized
+    9: no majority of the servers agrees on the time (see add_server())
+    10: server limits the rate (kiss code RATE), the poll period is raised
+    11: server denies access (kiss code DENY or RSTR), it is not asked again
+    12: synchronization distance of server too large (see set_max_distance())
   */
   uint8_t update();
 
@@ -140,24 +540,100 @@ class precise_sntp {
     Get time from server and adapt the poll period.
 
     After the first contact the poll policy of the server is used.
-    The smallest allowed poll exponent is used. On successful polls
-    the poll exponent is incremented. On unsuccessful polls the poll
-    exponent is decremented.
+    The smallest allowed poll exponent is used. Then the poll-adjust of
+    RFC 5905 is used: The offset of each successful poll is compared to
+    the clock jitter (the averaged differences of successive offsets). The
+    poll exponent is incremented after several small offsets (e. g. network
+    jitter) and decremented after a few large offsets (e. g. a wandering
+    frequency of the oscillator) with hysteresis.
+    Unsuccessful polls do not change the poll exponent.
+    The poll exponent stays in the range of set_poll_exponent_range(), also
+    after the range was changed (see get_poll_exponent()).
 
     returns an error code:
 
     0: success
     1: poll policy does not allow fast updates, skip communication with server
-    2: cannot use local port _localport
+    2: cannot use local port PRECISE_SNTP_LOCAL_PORT
     3: cannot start connection
     4: problems writing data
     5: packet was not send
     6: got no answer from server
     7: sanity check fail, answer from server is bogus
     8: sanity check fail, server is not synchronized
+    9: no majority of the servers agrees on the time (see add_server())
+    10: server limits the rate (kiss code RATE), the poll period is raised
+    11: server denies access (kiss code DENY or RSTR), it is not asked again
+    12: synchronization distance of server too large (see set_max_distance())
    */
   uint8_t update_adapt_poll_period();
 
+  /*
+    Non-blocking variant of update() and update_adapt_poll_period().
+
+    Call it regularly, e. g. in every loop(). If a poll is due it is started
+    and every call advances the running poll by one step (see service()).
+    No call waits for the server.
+
+    If adapt_poll_period is set to true, the poll period is adapted like
+    in update_adapt_poll_period().
+
+    returns an error code:
+
+    1: poll policy does not allow fast updates, skip communication with server
+    PRECISE_SNTP_POLL_PENDING: poll is running, call again later
+    or when a poll finished the error code of service()
+  */
+  uint8_t update_async(bool adapt_poll_period=false);
+
+  /*
+    Starts an asynchronous poll of the time server regardless of the poll
+    policy. The poll is done by calling service() until it does not return
+    PRECISE_SNTP_POLL_PENDING anymore.
+
+    use_transmit_timestamp has the same meaning as in force_update().
+
+    returns false if a poll is already running, otherwise true
+  */
+  bool begin_poll(bool use_transmit_timestamp=false);
+
+  /*
+    Advances the running poll (or iburst, see begin_iburst()) by one step:
+    send request, await reply, validate reply and apply reply.
+    It never waits for the server, so each call returns quickly.
+
+    returns an error code:
+
+    1: no poll is running
+    PRECISE_SNTP_POLL_PENDING: poll is running, call again later
+    or when the poll finished in this call (like force_update()):
+    0: success
+    2: cannot use local port PRECISE_SNTP_LOCAL_PORT
+    3: cannot start connection
+    4: problems writing data
+    5: packet was not send
+    6: got no answer from server
+    7: sanity check fail, answer from server is bogus
+    8: sanity check fail, server is not synchronized
+    9: no majority of the servers agrees on the time (see add_server())
+    10: server limits the rate (kiss code RATE), the poll period is raised
+    11: server denies access (kiss code DENY or RSTR), it is not asked again
+    12: synchronization distance of server too large (see set_max_distance())
+  */
+  uint8_t service();
+
+  /*
+    Returns the actual state of the poll engine.
+  */
+  precise_sntp_poll_state get_poll_state();
+
+  /*
+    Sets a function called each time a poll finished.
+    The error code of the poll (like returned by service()) is given
+    as argument. Use NULL to remove the callback.
+  */
+  void set_poll_callback(void (*callback)(uint8_t result));
+
   /*
     Returns the actual time as epoch (unix timestamp) in seconds.
    */
@@ -172,14 +648,44 @@ class precise_sntp {
   /*
     Returns the actual time as epoch (unix timestamp) in seconds
     and fractions of the second. This is the full calculated precision.
-    But since the local clock is not adjusted this precision reflects
+    But since the local clock is based on millis() this precision reflects
     not the reality. You could expect a precision of a few milliseconds.
+    With PRECISE_SNTP_USE_MICROS the local clock is based on micros() and
+    sub-millisecond precision is possible in local networks.
   */
   timestamp_format tget_epoch(); // seconds + fraction of the second
 
+  /*
+    Returns the actual time like tget_epoch() and the maximal error of it
+    (error bound): the true time is within +- error of the returned time.
+
+    The error is the synchronization distance of the system peer at the
+    last good sample (see get_sync_distance()) plus the correction not
+    slewed yet. It grows with the time since the last good sample by the
+    frequency tolerance (15 ppm) and the wander of the learned frequency.
+    So without an answer of the servers (holdover) the quality of the
+    time is still known. With only a few samples in the clock filter the
+    error is large (seconds), an iburst (see begin_iburst()) fills it.
+    If the clock was never set, the error is 0xFFFFFFFFFFFFFFFF.
+
+    In contrast to tget_epoch() it has to be called from the main loop.
+  */
+  timestamp_with_error_format tget_epoch_with_error();
+
+  /*
+    Set the maximal error in milliseconds (see tget_epoch_with_error()) for
+    is_synchronized(). 0 (default) keeps the definition by the poll period.
+  */
+  void set_max_error(unsigned long milliseconds);
+
   /*
     returns true if clock was once updated and
     the next update time is not reached
+
+    If a maximal error is set by set_max_error(), it returns true if the
+    clock was set and the error bound is below this maximal error. So
+    after losing the servers it stays true as long as the time is good
+    enough (holdover).
   */
   bool is_synchronized();
 
@@ -191,9 +697,11 @@ class precise_sntp {
     between the pulls. The first time the transmit timestamp of the
     ntp server is used to set the local clock provided by this library.
 
-    Since no mitigation algorithms (clock filter, clock adjust, ...) are
-    used, it does not make sense to do a high number of pulls. Therefore
-    n is 2 as default and not the typical 8 used by NTP implementations.
+    All pulls after the first one are fed into the clock filter, which
+    selects the sample with the lowest round-trip delay. Therefore more
+    pulls (up to PRECISE_SNTP_FILTER_STAGES + 1, e. g. n=9) improve the
+    offset accuracy. For compatibility n is 2 as default and not the typical
+    8 used by NTP implementations.
 
     The return value combines results of all pulls: In the least
     significant 4 Bits is the return value of the first pull.
@@ -207,6 +715,78 @@ class precise_sntp {
    */
   uint64_t force_update_iburst(uint8_t n=2, uint16_t d=2000);
 
+  /*
+    Non-blocking and pipelined variant of force_update_iburst().
+
+    n requests are sent with an interval of d milliseconds, distributed
+    over all servers (see add_server()). Up to PRECISE_SNTP_IBURST_SLOTS
+    requests wait at the same time for their answer, which is matched by
+    the origin timestamp. If the local clock was never set, the first valid
+    answer sets it. All further valid answers are fed into the clock filters
+    and at the end one selection corrects the local clock.
+
+    The iburst is done by calling service() (or update_async()) until it
+    does not return PRECISE_SNTP_POLL_PENDING anymore. The progress is
+    given by get_iburst_status(). With the defaults the iburst takes about
+    2 seconds. Public servers may send a kiss-o'-death packet (rate
+    exceeded), if d is too small.
+
+    returns false if a poll is already running, otherwise true
+
+    Example:
+
+    void setup() {
+      sntp.begin_iburst();
+    }
+    void loop() {
+      sntp.update_async();
+    }
+  */
+  bool begin_iburst(uint8_t n=8, uint16_t d=250);
+
+  /*
+    Returns the progress of the last iburst started by begin_iburst().
+  */
+  struct precise_sntp_iburst_status get_iburst_status();
+
+  /*
+    Switches to broadcast client mode (RFC 5905 section 8): The servers are
+    not polled anymore, update_async() (and update()) only listen for
+    broadcast packets (mode 5) of the servers on port and correct the
+    local clock. So the network traffic does not grow with the number of
+    clients.
+
+    A broadcast packet has no receive timestamp, so the one-way delay
+    cannot be measured. It is calibrated before by a unicast exchange
+    (force_update()) with each server: the half of the round-trip delay
+    is used. Broadcast packets of servers without a calibrated delay or
+    given only by name (without set_resolver()) are ignored.
+
+    In broadcast mode update_async() returns 1, if no broadcast packet is
+    waiting, and 7 for a packet of an unknown sender or no broadcast
+    packet. Otherwise it returns the error code like update().
+
+    Example:
+
+    void setup() {
+      sntp.begin_broadcast();
+    }
+    void loop() {
+      sntp.update_async();
+    }
+
+    returns true on success, false if the calibration failed or port
+    cannot be used (the client stays in unicast mode)
+  */
+  bool begin_broadcast(uint16_t port = 123);
+
+  /*
+    Leaves the broadcast client mode and polls the servers again,
+    e. g. if no broadcast packet was received for a long time
+    (see get_last_update()).
+  */
+  void end_broadcast();
+
   /*
     force_update() gets the time from server. It should only be used in
     local networks with local time server, e. g. for debugging purposes.
@@ -216,46 +796,452 @@ class precise_sntp {
     If use_transmit_timestamp is set to false (the default), the averaged
     offset theta from ntp server is used to decide whether to use the
     transmit timestamp or to correct the time using the offset theta.
-    For theta > 1 second the transmit timestamp is used.
-    Otherwise (theta <= 1 second) the time is corrected using theta.
+    If the local clock was never set, the transmit timestamp is used.
+    Otherwise the sample is fed into the clock filter (for theta > 1 second
+    the filter of this server is cleared before).
+    The filter selects from the last PRECISE_SNTP_FILTER_STAGES samples
+    the one with the lowest round-trip delay and the time is corrected
+    using its offset, if this sample was not used before.
     The latter case makes sense and is the expected behavior after initial
     time setting.
+    With several servers (see add_server()) the time is corrected by the
+    combined offset of the surviving servers. A combined offset larger than
+    1 second steps the clock and all clock filters are cleared.
 
     returns an error code:
 
     0: success
-    2: cannot use local port _localport
+    2: cannot use local port PRECISE_SNTP_LOCAL_PORT
     3: cannot start connection
     4: problems writing data
     5: packet was not send
     6: got no answer from server
     7: sanity check fail, answer from server is bogus
     8: sanity check fail, server is not synchronized
+    9: no majority of the servers agrees on the time (see add_server())
+    10: server limits the rate (kiss code RATE), the poll period is raised
+    11: server denies access (kiss code DENY or RSTR), it is not asked again
+    12: synchronization distance of server too large (see set_max_distance())
+    13: a poll or iburst is already running (see begin_poll() and
+        begin_iburst()), nothing is done
   */
   uint8_t force_update(bool use_transmit_timestamp=false);
 
   /*
     Returns the ntp local clock in ntp timestamp format.
+
+    This (and get_epoch(), dget_epoch() and tget_epoch()) can be called in
+    an interrupt or on another core: It never blocks and never sees a
+    partly updated clock. All other methods have to be called from the
+    main loop only.
   */
   struct ntp_timestamp_format_struct get_local_clock();
 
+  /*
+    Returns the ntp local clock in ntp timestamp format, but it never goes
+    backwards: After the clock was stepped back it stays at the clock
+    before the step until the local clock reaches it again.
+
+    Like get_local_clock() it can be called in an interrupt or on another
+    core. Use it for time stamps of events, which have to be in order, and
+    for durations.
+  */
+  struct ntp_timestamp_format_struct get_monotonic_clock();
+
+  /*
+    Converts n captured ticks (values of millis() or micros() if
+    PRECISE_SNTP_USE_MICROS is defined) to the local clock in ntp timestamp
+    format, e. g. time stamps of events stored by an interrupt.
+
+    All ticks are converted with one snapshot of the clock state, which
+    is much faster than converting them one by one. The ticks have to be
+    taken before the call and at most 2^32 ticks before (about 49 days
+    with millis() and 71 minutes with micros()). Ticks before the last
+    correction of the clock are converted with the actual correction.
+
+    Like get_local_clock() it can be called in an interrupt or on another
+    core.
+
+    Example:
+
+    unsigned long ticks[64]; // filled by an interrupt
+    struct ntp_timestamp_format_struct clock[64];
+    sntp.convert_ticks(ticks, clock, 64);
+  */
+  void convert_ticks(const unsigned long *ticks,
+		     struct ntp_timestamp_format_struct *clock, size_t n);
+
+  /*
+    Like convert_ticks(), but converts to epoch (unix timestamp) in seconds
+    and fractions of the second (see tget_epoch()).
+  */
+  void convert_ticks_epoch(const unsigned long *ticks,
+			   struct timestamp_format *epoch, size_t n);
+
+  /*
+    Like convert_ticks(), but converts each tick with the local clock as it
+    was at that time, e. g. for events buffered for minutes before they
+    are sent: a correction of the clock (step or slew) after an event does
+    not change its time stamp.
+
+    The last PRECISE_SNTP_HISTORY (default 8) corrections of the local
+    clock are kept. The correction in effect at each tick is found by
+    binary search and the clock is interpolated from it. Ticks before the
+    oldest kept correction are extrapolated from it. The ticks have to be
+    taken at most 2^32 ticks before the call.
+
+    Unlike convert_ticks() it must not be called in an interrupt.
+
+    Example:
+
+    unsigned long event = millis();
+    ...
+    sntp.update();
+    struct ntp_timestamp_format_struct clock;
+    sntp.convert_past_ticks(&event, &clock, 1);
+  */
+  void convert_past_ticks(const unsigned long *ticks,
+			  struct ntp_timestamp_format_struct *clock, size_t n);
+
+  /*
+    Like convert_past_ticks(), but converts to epoch (unix timestamp) in
+    seconds and fractions of the second (see tget_epoch()).
+  */
+  void convert_past_ticks_epoch(const unsigned long *ticks,
+				struct timestamp_format *epoch, size_t n);
+
+  /*
+    Set the maximal rate in ppm (at most 500) to slew corrections of the
+    local clock. Instead of stepping the clock by the correction at once,
+    the clock runs a bit faster or slower until the correction is applied,
+    e. g. a correction of 5 ms needs at least 10 seconds with 500 ppm.
+    So get_local_clock() does not jump at each correction.
+    Corrections larger than 1 second still step the clock.
+    0 (default) steps the clock at each correction.
+  */
+  void set_slew_rate(uint16_t ppm);
+
   /*
     return the millis when the last update from the time server was successful
   */
   unsigned long get_last_update();
 
+  /*
+    Returns the offset of the sample selected by the clock filter
+    of the system peer (see get_system_peer()) in units of 2^-32 seconds.
+
+    The offsets of the filter are corrected when the local clock is
+    corrected. Therefore, it is about 0 after the clock was corrected.
+  */
+  int64_t get_offset();
+
+  /*
+    Returns the round-trip delay of the sample selected by the clock filter
+    of the system peer in units of 2^-32 seconds.
+  */
+  uint64_t get_delay();
+
+  /*
+    Returns the jitter of the clock filter of the system peer (root mean
+    square of the offset differences to the selected sample) in units of
+    2^-32 seconds.
+  */
+  uint64_t get_jitter();
+
+  /*
+    Returns the synchronization distance (root distance) of the system peer
+    in units of 2^-32 seconds: half of the round-trip delay to the primary
+    reference plus the dispersion of the server and of the clock filter and
+    the jitter. The true time is within this distance of the local clock
+    (after the last correction plus the drift since then).
+  */
+  uint64_t get_sync_distance();
+
+  /*
+    Returns the leap indicator announced by the system peer:
+
+    0: no warning
+    1: the last minute of the day has 61 seconds
+    2: the last minute of the day has 59 seconds
+  */
+  uint8_t get_leap_indicator();
+
+  /*
+    Set the maximal synchronization distance of a server in milliseconds
+    (root delay / 2 + root dispersion announced by the server). Answers
+    with a larger distance are rejected (error code 12). Default is
+    1500 ms like in RFC 5905.
+  */
+  void set_max_distance(uint16_t milliseconds);
+
+  /*
+    Returns the stratum of the system peer (1: primary server) or 0,
+    if no server answered yet.
+  */
+  uint8_t get_stratum();
+
+  /*
+    Returns the round-trip delay to the primary reference (root delay of
+    the system peer and the delay to it) in units of 2^-32 seconds.
+  */
+  uint64_t get_root_delay();
+
+  /*
+    Returns the IPv4 address of the system peer as reference id
+    (e. g. 0xC0A8B201 for 192.168.178.1) or 0, if it is not known.
+  */
+  uint32_t get_reference_id();
+
+  /*
+    Returns the precision of the local clock as exponent of 2,
+    e. g. -10 (about 1 ms) for millis().
+  */
+  int8_t get_precision();
+
+  /*
+    Returns the learned frequency correction of the local clock in units
+    of 2^-32 (4295 is about 1 ppm).
+
+    A positive value means the local oscillator (millis() or micros()) is
+    too slow and get_local_clock() runs faster to compensate.
+    The frequency is learned from the offsets of successive polls
+    (frequency-lock loop of RFC 5905) and is limited to +-500 ppm.
+  */
+  int32_t get_frequency();
+
+  /*
+    Sets a function, which gives the time a packet was received.
+
+    Without it the receive time T4 is taken when parsePacket() first
+    reports the answer of the server, so it contains the time until
+    service() is called. If the UDP driver can take the time in an
+    interrupt (e. g. the interrupt pin of the network chip), the hook
+    should store this time as millis() (or micros() if
+    PRECISE_SNTP_USE_MICROS is defined) in ticks and return true.
+    If it returns false, the time of parsePacket() is used.
+    Use NULL to remove the hook.
+
+    Example:
+
+    volatile unsigned long rx_ticks;
+    void on_rx_interrupt() { rx_ticks = millis(); }
+    bool rx_hook(unsigned long *ticks) {
+      *ticks = rx_ticks;
+      return true;
+    }
+    void setup() {
+      attachInterrupt(digitalPinToInterrupt(2), on_rx_interrupt, FALLING);
+      sntp.set_receive_timestamp_hook(rx_hook);
+    }
+  */
+  void set_receive_timestamp_hook(bool (*hook)(unsigned long *ticks));
+
+  /*
+    Writes the learned state to buffer (PRECISE_SNTP_STATE_SIZE bytes), so
+    after a reboot import_state() continues from it (warm start) instead of
+    learning everything again:
+
+    - frequency correction of the local oscillator
+    - wander of the frequency (see tget_epoch_with_error())
+    - poll exponent and hysteresis counter of the poll-adjust
+    - system peer (index and address of the last good server)
+
+    The blob is versioned (PRECISE_SNTP_STATE_VERSION) and ends with a
+    CRC-16 over all other bytes. Multi-byte values are little-endian, so
+    a blob of a board can be read on a host and vice versa.
+
+    returns the number of bytes written or 0 if size is too small
+  */
+  size_t export_state(uint8_t *buffer, size_t size);
+
+  /*
+    Restores the state written by export_state(). Blobs with another
+    version, a wrong size or CRC are ignored.
+
+    The frequency correction is used from now on. If the clock was
+    synchronized at the export, the first successful poll continues with
+    the exported poll exponent (update_adapt_poll_period() or
+    update_async(true)) instead of starting at the minimal one. If the
+    system peer has a name and a resolver is set (see set_resolver()),
+    its exported address is used until the resolve lifetime expires.
+    Call it after add_server(), set_resolver() and
+    set_poll_exponent_range().
+
+    returns true if the state was restored
+  */
+  bool import_state(const uint8_t *buffer, size_t size);
+
+  /*
+    Exports the state (see export_state()) and writes it to storage.
+    Flash memory wears out, so do not save after each poll, e. g. only
+    once a day or when the poll exponent changed.
+
+    Example:
+
+    #include <precise_sntp_storage.h>
+    my_storage storage; // implements precise_sntp_storage
+    unsigned long last_save = 0;
+    void setup() {
+      sntp.load_state(storage);
+    }
+    void loop() {
+      if ((sntp.update_adapt_poll_period() == 0) &&
+          ((last_save == 0) || (millis() - last_save > 86400000UL))) {
+        sntp.save_state(storage);
+        last_save = millis();
+      }
+    }
+
+    returns true on success
+  */
+  bool save_state(precise_sntp_storage &storage);
+
+  /*
+    Reads the state from storage and imports it (see import_state()).
+
+    returns true if the state was restored
+  */
+  bool load_state(precise_sntp_storage &storage);
+
+#ifdef PRECISE_SNTP_STATISTICS
+  /*
+    Returns a snapshot of the statistics collected since the start or
+    the last reset_statistics(). It is only available if
+    PRECISE_SNTP_STATISTICS is defined.
+
+    Example:
+
+    struct precise_sntp_statistics stat = sntp.get_statistics();
+    Serial.println(stat.results[0]); // successful polls
+  */
+  struct precise_sntp_statistics get_statistics();
+
+  /*
+    Resets all statistics.
+  */
+  void reset_statistics();
+#endif
+
  private:
-  IPAddress _ntp_server_ip;
-  const char* _ntp_server_name;
-  UDP* _udp;
-  uint16_t _localport = 1234;
-  union ntp_local_clock_union _ntp_local_clock;
-  unsigned long _last_clock_update = 0;
+  uint8_t send_request();
+  uint8_t await_reply();
+  uint8_t validate_reply();
+  uint8_t filter_reply();
+  uint8_t apply_samples();
+  uint8_t next_association(uint8_t result);
+  void store_result(uint8_t result);
+  uint8_t send_packet(struct precise_sntp_association *server);
+  uint64_t receive_ticks(uint64_t t1_ticks, uint64_t t4_ticks);
+  uint8_t read_reply(uint8_t mode,
+		     const struct ntp_timestamp_format_struct *xmt, uint8_t n);
+  void add_sample();
+  uint8_t iburst_step();
+  uint8_t receive_broadcast();
+  uint8_t service_step();
+  uint8_t select_clock(unsigned long now, uint8_t *survivors,
+		       uint64_t *distance);
+  uint8_t finish_poll(uint8_t result);
+  uint8_t wait_for_poll();
+  void set_local_clock(uint64_t clock);
+  void anchor_clock(uint64_t clock, uint64_t ticks, int64_t slew);
+  uint64_t read_local_clock(bool monotonic);
+  void convert_ticks_parameter(
+    struct precise_sntp_convert_ticks_parameter *parameter);
+  uint64_t error_bound(unsigned long now);
+  uint64_t get_ticks();
+  uint64_t ticks2clock(uint64_t ticks);
+  uint64_t past_ticks2clock(uint64_t now, unsigned long ticks);
+  void discipline_frequency(int64_t offset, unsigned long mu);
+  void publish_clock();
+  uint8_t clamp_poll_exponent(uint8_t poll);
+  void update_clock_jitter(int64_t offset);
+  void adjust_poll_exponent(bool good);
+  uint32_t random32();
+  unsigned long random_delay(unsigned long max_delay);
+  bool init_association(IPAddress ntp_server_ip, const char* ntp_server_name);
+  void resolve_association(struct precise_sntp_association *association);
+  void clear_filters();
+
+  struct precise_sntp_association _associations[PRECISE_SNTP_MAX_SERVERS];
+  uint8_t _number_of_associations = 0;
+  uint8_t _association = 0; // index of the polled server
+  uint8_t _system_peer = 0;
+  uint8_t _number_of_survivors = 0;
+  bool _round_success = false; // at least one server answered in this poll
+  bool _round_stepped = false; // the clock was set in this poll
+  uint8_t _round_result = 0; // last error code of a server in this poll
+  bool _round_corrected = false; // the clock was corrected in this poll
+  int64_t _round_offset = 0; // combined offset of this poll
+  int8_t _poll_counter = 0; // hysteresis counter of the poll-adjust
+  uint64_t _clock_jitter = 0; // clock jitter of the poll-adjust
+  int64_t _last_offset = 0; // last correction (for the clock jitter)
+  bool _clock_set = false; // the local clock was set once
+  bool _correction_used = false; // _last_correction is valid
+  unsigned long _last_correction = 0; // sample time of the last correction
+  PRECISE_SNTP_UDP_TYPE* _udp;
+  // the clock state is only written by the main loop, readers in an
+  // interrupt or on another core use the published copies (latch)
+  struct precise_sntp_clock_state _clock;
+  struct precise_sntp_clock_state _clock_latch[2];
+  volatile uint8_t _clock_sequence = 0;
+  // corrections of the local clock for convert_past_ticks()
+  struct precise_sntp_clock_history _history = {};
+  uint64_t _history_base = 0; // continuous ticks minus the extended ticks
   unsigned long _last_update = 0;
   unsigned long _next_update_period = 0;
   uint8_t _poll_exponent = 1;
   bool _is_synced = false;
   uint8_t _min_poll_exponent = 6; // 4 is NTPv4 minimal poll exponent (16 s)
   uint8_t _max_poll_exponent = 10; // 17 is NTPv4 maximal poll exponent (36 h)
-  uint16_t _millis_overflow_count = 0;
+  precise_sntp_poll_state _poll_state = PRECISE_SNTP_POLL_IDLE;
+  bool _use_transmit_timestamp = false;
+  bool _adapt_poll_period = false;
+  bool _was_synchronized = false;
+  uint8_t _old_poll_exponent = 1;
+  unsigned long _start_waiting = 0;
+  struct ntp_timestamp_format_struct _xmt; // opaque transmit timestamp
+  uint64_t _t1_ticks = 0; // extended ticks when the request was sent
+  struct ntp_timestamp_format_struct _t2;
+  struct ntp_timestamp_format_struct _t3;
+  uint64_t _t4_ticks = 0; // extended ticks when the answer was received
+  uint32_t _random_state = 0;
+  unsigned long _max_start_delay = 0; // milliseconds
+  bool _start_delay_pending = true; // the start delay was not chosen yet
+  uint8_t _poll_jitter = 0; // percent
+  uint8_t _backoff = 0; // number of unsuccessful polls in a row
+  unsigned long _retry_start = 0; // millis() at the start of _retry_delay
+  unsigned long _retry_delay = 0; // milliseconds without a poll
+  bool (*_receive_timestamp_hook)(unsigned long *ticks) = NULL;
+  int (*_resolver)(const char* name, IPAddress &ip) = NULL;
+  unsigned long _resolve_lifetime = 3600000UL; // milliseconds
+  int8_t _server_precision = 0;
+  uint8_t _reply_leap = 0; // leap indicator of the last answer
+  uint8_t _reply_stratum = 0; // stratum of the last answer
+  uint32_t _reply_rootdelay = 0; // root delay of the last answer
+  uint32_t _reply_rootdisp = 0; // root dispersion of the last answer
+  uint16_t _max_distance = 1500; // milliseconds
+  bool _round_rate_limited = false; // kiss code RATE in this poll
+  uint8_t _reply_poll = 0; // poll exponent of the last answer
+  uint8_t _reply_index = 0; // index of the matching transmit timestamp
+  struct precise_sntp_iburst_status _iburst;
+  struct precise_sntp_iburst_slot _iburst_slots[PRECISE_SNTP_IBURST_SLOTS];
+  uint16_t _iburst_interval = 0;
+  unsigned long _iburst_last_send = 0;
+  void (*_poll_callback)(uint8_t result) = NULL;
+  bool _broadcast = false; // broadcast client mode
+  uint32_t _wander = 0; // mean change of the frequency in units of 2^-32
+  unsigned long _max_error = 0; // milliseconds, 0: use the poll period
+  bool _warm_start = false; // the next poll continues the imported state
+#ifdef PRECISE_SNTP_STATISTICS
+  void statistics_add_sample(int64_t offset, uint64_t delay,
+			     uint64_t dispersion);
+  struct precise_sntp_statistics _statistics = {};
+  int64_t _statistics_offset_sum = 0;
+  uint64_t _statistics_delay_sum = 0;
+  struct precise_sntp_statistics_sample
+  _statistics_samples[PRECISE_SNTP_STATISTICS_SAMPLES] = {}; // ring buffer
+  uint8_t _statistics_next_sample = 0; // next index in _statistics_samples
+  unsigned long _statistics_poll_start = 0; // micros()
+  unsigned long _statistics_service_time = 0; // micros() in this poll
+#endif
 };
@@ -0,0 +1,100 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  History of the corrections of the local clock: a ring buffer of the
+  last PRECISE_SNTP_HISTORY segments. Each segment starts at a correction
+  (the clock was set or a slew started) and gives the local clock until
+  the next one, so ticks captured in the past can be converted with the
+  clock as it was at that time (see precise_sntp::convert_past_ticks()).
+
+  The ticks of the segments are counted continuously (they do not start
+  again at a correction) and increase from the oldest to the newest
+  segment, so the segment of given ticks is found by binary search.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// number of corrections of the local clock kept in the history
+#ifndef PRECISE_SNTP_HISTORY
+#define PRECISE_SNTP_HISTORY 8
+#endif
+
+/*
+  The local clock was set to clock at ticks and runs with the frequency
+  correction since then; the correction slew is applied with at most
+  slew_rate.
+*/
+struct precise_sntp_clock_segment {
+  uint64_t ticks; // continuous ticks at the start of the segment
+  uint64_t clock; // local clock at the start (2^-32 seconds)
+  int64_t slew; // correction to slew in units of 2^-32 seconds
+  int32_t frequency; // frequency correction in units of 2^-32
+  uint32_t slew_rate; // maximal slew rate in units of 2^-32
+};
+
+struct precise_sntp_clock_history {
+  struct precise_sntp_clock_segment segments[PRECISE_SNTP_HISTORY];
+  uint8_t next; // index of the next segment
+  uint8_t count; // number of valid segments
+};
+
+/*
+  returns the i-th segment counted from the oldest one
+*/
+static inline struct precise_sntp_clock_segment* precise_sntp_clock_history_at(
+  struct precise_sntp_clock_history *h, uint8_t i) {
+  return &(h->segments[(h->next + PRECISE_SNTP_HISTORY - h->count + i) %
+		       PRECISE_SNTP_HISTORY]);
+}
+
+/*
+  returns the newest segment or NULL if the history is empty
+*/
+static inline struct precise_sntp_clock_segment*
+precise_sntp_clock_history_newest(struct precise_sntp_clock_history *h) {
+  return (h->count > 0) ? precise_sntp_clock_history_at(h, h->count - 1) :
+    NULL;
+}
+
+/*
+  returns a new segment (the newest one), which replaces the oldest one
+  if the history is full
+*/
+static inline struct precise_sntp_clock_segment*
+precise_sntp_clock_history_add(struct precise_sntp_clock_history *h) {
+  struct precise_sntp_clock_segment *s = &(h->segments[h->next]);
+  h->next = (h->next + 1) % PRECISE_SNTP_HISTORY;
+  if (h->count < PRECISE_SNTP_HISTORY) {
+    h->count++;
+  }
+  return s;
+}
+
+/*
+  returns the newest segment starting at or before ticks (binary search),
+  the oldest one if ticks is before all segments and NULL if the history
+  is empty
+*/
+static inline struct precise_sntp_clock_segment*
+precise_sntp_clock_history_find(struct precise_sntp_clock_history *h,
+				uint64_t ticks) {
+  if (h->count == 0) {
+    return NULL;
+  }
+  // the segment is in [low, high)
+  uint8_t low = 0;
+  uint8_t high = h->count;
+  while (high - low > 1) {
+    const uint8_t middle = (uint8_t) ((low + high) / 2);
+    if (precise_sntp_clock_history_at(h, middle)->ticks <= ticks) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+  return precise_sntp_clock_history_at(h, low);
+}
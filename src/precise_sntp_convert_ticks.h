@@ -0,0 +1,81 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Batch conversion of captured ticks (millis() or micros(), e. g. stored
+  by an interrupt in a ring buffer) to the local clock.
+
+  The coefficients of the local clock are taken once from a snapshot of
+  the clock state (struct precise_sntp_convert_ticks_parameter). The loop
+  over the buffer uses only multiplications, shifts and selects (no
+  division and no branch), so the compiler can unroll and vectorize it.
+
+  Each tick value is interpreted as the last time before the snapshot
+  with these ticks (at most 2^32 ticks before, about 49 days with millis()
+  and 71 minutes with micros()). Ticks before the last clock update are
+  extrapolated with the actual frequency.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <precise_sntp.h>
+
+struct precise_sntp_convert_ticks_parameter {
+  unsigned long now_ticks; // ticks of the snapshot
+  int64_t elapsed; // duration since the last clock update (2^-32 s)
+  uint64_t clock; // local clock at the last clock update (2^-32 s)
+  int32_t frequency; // frequency correction in units of 2^-32
+  uint32_t slew_rate; // maximal slew rate in units of 2^-32
+  int64_t slew; // correction to slew in units of 2^-32 seconds
+  uint32_t per_tick_int; // duration of one tick (integer part)
+  uint32_t per_tick_frac; // duration of one tick (fraction)
+};
+
+/*
+  returns the local clock (units of 2^-32 seconds) at ticks
+*/
+static inline uint64_t precise_sntp_convert_tick(
+  const struct precise_sntp_convert_ticks_parameter *p, unsigned long ticks) {
+  const uint64_t age = (uint32_t) (p->now_ticks - ticks);
+  const uint64_t age_duration = age * p->per_tick_int +
+    ((age * p->per_tick_frac + 0x80000000UL) >> 32);
+  const int64_t elapsed = p->elapsed - (int64_t) age_duration;
+  const int64_t correction =
+    ((elapsed >> 16) * p->frequency) / (((int64_t) 1) << 16);
+  // the slew starts at the last clock update
+  const uint64_t positive = (elapsed > 0) ? (uint64_t) elapsed : 0;
+  const int64_t max_slew = (int64_t) (((positive >> 16) * p->slew_rate) >> 16);
+  int64_t slewed = (p->slew > max_slew) ? max_slew : p->slew;
+  slewed = (slewed < -max_slew) ? -max_slew : slewed;
+  return p->clock + elapsed + correction + slewed;
+}
+
+/*
+  converts n ticks to the local clock in ntp timestamp format
+*/
+static inline void precise_sntp_convert_ticks(
+  const struct precise_sntp_convert_ticks_parameter *p,
+  const unsigned long *ticks, struct ntp_timestamp_format_struct *clock,
+  size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t c = precise_sntp_convert_tick(p, ticks[i]);
+    clock[i].seconds = (uint32_t) (c >> 32);
+    clock[i].fraction = (uint32_t) c;
+  }
+}
+
+/*
+  converts n ticks to the local clock as epoch (unix timestamp)
+*/
+static inline void precise_sntp_convert_ticks_epoch(
+  const struct precise_sntp_convert_ticks_parameter *p,
+  const unsigned long *ticks, struct timestamp_format *epoch, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t c = precise_sntp_convert_tick(p, ticks[i]);
+    epoch[i].seconds = (uint32_t) (c >> 32) - 2208988800UL;
+    epoch[i].fraction = (uint32_t) c;
+  }
+}
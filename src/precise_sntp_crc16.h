@@ -0,0 +1,29 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF), e. g. used
+  to check the saved state (see precise_sntp::export_state()).
+
+  It is computed bitwise: no table is needed for the few bytes.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  returns the CRC of the n bytes of data
+*/
+static inline uint16_t precise_sntp_crc16(const uint8_t *data, size_t n) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < n; i++) {
+    crc ^= (uint16_t) (((uint16_t) data[i]) << 8);
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ 0x1021) :
+	(uint16_t) (crc << 1);
+    }
+  }
+  return crc;
+}
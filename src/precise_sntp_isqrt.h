@@ -0,0 +1,31 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Integer square root, used to calculate the jitter without floating point.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+  returns floor(sqrt(x))
+*/
+static inline uint64_t precise_sntp_isqrt64(uint64_t x) {
+  uint64_t result = 0;
+  uint64_t bit = ((uint64_t) 1) << 62;
+  while (bit > x) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (x >= result + bit) {
+      x -= result + bit;
+      result = (result >> 1) + bit;
+    } else {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return result;
+}
@@ -0,0 +1,54 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Latch (double buffered sequence lock) to publish a small state to
+  readers in an interrupt or on another core.
+
+  The writer keeps two copies: while the sequence is odd the readers use
+  copy 1 and copy 0 is written, then the sequence gets even and copy 1 is
+  written. So a reader interrupting the writer always finds a complete
+  copy and never waits. A reader on another core repeats its copy only if
+  the writer was active meanwhile. The writer never waits.
+
+  There must be only one writer (e. g. the main loop).
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#define PRECISE_SNTP_MEMORY_BARRIER() __sync_synchronize()
+
+/*
+  writes size bytes of value to both copies (an array of 2 elements
+  of size bytes) and advances the sequence by 2
+*/
+static inline void precise_sntp_latch_write(volatile uint8_t *sequence,
+					    void *copies, const void *value,
+					    size_t size) {
+  (*sequence)++; // odd: the readers use copy 1
+  PRECISE_SNTP_MEMORY_BARRIER();
+  memcpy(copies, value, size);
+  PRECISE_SNTP_MEMORY_BARRIER();
+  (*sequence)++; // even: the readers use copy 0
+  PRECISE_SNTP_MEMORY_BARRIER();
+  memcpy(((uint8_t *) copies) + size, value, size);
+  PRECISE_SNTP_MEMORY_BARRIER();
+}
+
+/*
+  reads size bytes to value from the copy not written at the moment
+*/
+static inline void precise_sntp_latch_read(const volatile uint8_t *sequence,
+					   const void *copies, void *value,
+					   size_t size) {
+  uint8_t s;
+  do {
+    s = *sequence;
+    PRECISE_SNTP_MEMORY_BARRIER();
+    memcpy(value, ((const uint8_t *) copies) + (s & 1) * size, size);
+    PRECISE_SNTP_MEMORY_BARRIER();
+  } while (s != *sequence);
+}
@@ -0,0 +1,53 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Layout of an ntp packet (RFC 5905 section 7.3) without extension fields
+  and the conversion of its fields between host and network byte order.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <precise_sntp.h>
+#include <precise_sntp_htonl_htons.h>
+
+#define NTP_PACKET_SIZE 48
+
+struct ntp_short_format_struct { // 4 bytes
+  uint16_t seconds;
+  uint16_t fraction;
+};
+struct ntp_packet_struct { // 48 bytes, all in network byte order
+  byte leap_version_mode; // leap indicator, version number, mode
+  byte stratum;
+  byte poll; // poll exponent
+  byte precision; // precision exponent
+  struct ntp_short_format_struct rootdelay; // root delay
+  struct ntp_short_format_struct rootdisp; // root dispersion
+  byte refid[4]; // reference ID
+  struct ntp_timestamp_format_struct reftime; // reference timestamp
+  struct ntp_timestamp_format_struct org; // origin timestamp
+  struct ntp_timestamp_format_struct rec; // receive timestamp
+  struct ntp_timestamp_format_struct xmt; // transmit timestamp
+};
+union ntp_packet_union {
+  byte as_bytes[NTP_PACKET_SIZE];
+  struct ntp_packet_struct as_ntp_packet;
+};
+
+static inline void ntp_short_format_ntoh(ntp_short_format_struct *t) {
+  t->seconds = ntohs(t->seconds);
+  t->fraction = ntohs(t->fraction);
+}
+
+static inline void ntp_timestamp_format_ntoh(ntp_timestamp_format_struct *t) {
+  t->seconds = ntohl(t->seconds);
+  t->fraction = ntohl(t->fraction);
+}
+
+static inline void ntp_timestamp_format_hton(ntp_timestamp_format_struct *t) {
+  t->seconds = htonl(t->seconds);
+  t->fraction = htonl(t->fraction);
+}
@@ -0,0 +1,195 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Read-only view of a received ntp packet (RFC 5905 section 7.3) in the
+  receive buffer. The fields are decoded byte by byte when they are read,
+  so neither the byte order of the host nor the layout of a struct (see
+  precise_sntp_ntp_packet.h) matters and the buffer is neither copied nor
+  changed.
+
+  check() does all checks of the header of an answer in one pass.
+
+  Example:
+
+  uint8_t buffer[NTP_PACKET_SIZE];
+  const int size = udp.read(buffer, NTP_PACKET_SIZE);
+  const precise_sntp_ntp_packet_view packet(buffer);
+  uint8_t index;
+  if (packet.check(size, NTP_PACKET_VIEW_MODE_SERVER, &xmt, 1, &index) == 0) {
+    const struct ntp_timestamp_format_struct t3 = packet.xmt();
+  }
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <precise_sntp.h>
+
+// offsets of the fields in the packet
+#define NTP_PACKET_VIEW_ROOTDELAY 4
+#define NTP_PACKET_VIEW_ROOTDISP 8
+#define NTP_PACKET_VIEW_REFID 12
+#define NTP_PACKET_VIEW_REFTIME 16
+#define NTP_PACKET_VIEW_ORG 24
+#define NTP_PACKET_VIEW_REC 32
+#define NTP_PACKET_VIEW_XMT 40
+#define NTP_PACKET_VIEW_SIZE 48
+
+// modes of an answer
+#define NTP_PACKET_VIEW_MODE_SERVER 4
+#define NTP_PACKET_VIEW_MODE_BROADCAST 5
+
+class precise_sntp_ntp_packet_view {
+ public:
+  /*
+    data: received packet (at least NTP_PACKET_VIEW_SIZE bytes for the
+    accessors, check() tests the size)
+  */
+  explicit precise_sntp_ntp_packet_view(const uint8_t *data) : _data(data) {}
+
+  uint8_t leap() const {
+    return _data[0] >> 6;
+  }
+
+  uint8_t version() const {
+    return (_data[0] >> 3) & 0x07;
+  }
+
+  uint8_t mode() const {
+    return _data[0] & 0x07;
+  }
+
+  uint8_t stratum() const {
+    return _data[1];
+  }
+
+  uint8_t poll() const {
+    return _data[2];
+  }
+
+  int8_t precision() const {
+    return (int8_t) _data[3];
+  }
+
+  /*
+    root delay in ntp short format (16 bit seconds and 16 bit fraction)
+  */
+  uint32_t rootdelay() const {
+    return get32(NTP_PACKET_VIEW_ROOTDELAY);
+  }
+
+  /*
+    root dispersion in ntp short format (16 bit seconds and 16 bit
+    fraction)
+  */
+  uint32_t rootdisp() const {
+    return get32(NTP_PACKET_VIEW_ROOTDISP);
+  }
+
+  /*
+    reference id (4 bytes), the kiss code for stratum 0
+  */
+  const uint8_t* refid() const {
+    return _data + NTP_PACKET_VIEW_REFID;
+  }
+
+  struct ntp_timestamp_format_struct reftime() const {
+    return timestamp(NTP_PACKET_VIEW_REFTIME);
+  }
+
+  struct ntp_timestamp_format_struct org() const {
+    return timestamp(NTP_PACKET_VIEW_ORG);
+  }
+
+  struct ntp_timestamp_format_struct rec() const {
+    return timestamp(NTP_PACKET_VIEW_REC);
+  }
+
+  struct ntp_timestamp_format_struct xmt() const {
+    return timestamp(NTP_PACKET_VIEW_XMT);
+  }
+
+  /*
+    Checks the header of an answer of size bytes.
+
+    mode: expected mode (NTP_PACKET_VIEW_MODE_SERVER or
+    NTP_PACKET_VIEW_MODE_BROADCAST)
+    xmt: the n transmit timestamps of the waiting requests, one of them
+    has to be the origin timestamp of a server answer (not used for a
+    broadcast)
+    index: the matching transmit timestamp (n if none matches)
+
+    returns:
+      0: the answer can be used
+      7: bogus: too short, wrong mode or version (1 to 4), no matching
+         origin timestamp or a zero receive or transmit timestamp
+      8: the server is not synchronized (stratum 0 or above 15, leap 3)
+     10: kiss code RATE (stratum 0), the server limits the rate
+     11: kiss code DENY or RSTR (stratum 0), the server denies access
+  */
+  uint8_t check(size_t size, uint8_t mode,
+		const struct ntp_timestamp_format_struct *xmt, uint8_t n,
+		uint8_t *index) const {
+    *index = n;
+    if ((size < NTP_PACKET_VIEW_SIZE) || (this->mode() != mode) ||
+	(version() < 1) || (version() > 4)) {
+      return 7;
+    }
+    if (mode == NTP_PACKET_VIEW_MODE_SERVER) {
+      const uint32_t seconds = get32(NTP_PACKET_VIEW_ORG);
+      const uint32_t fraction = get32(NTP_PACKET_VIEW_ORG + 4);
+      uint8_t i = 0;
+      while ((i < n) &&
+	     ((xmt[i].seconds != seconds) || (xmt[i].fraction != fraction))) {
+	i++;
+      }
+      *index = i;
+      if (i == n) {
+	return 7;
+      }
+    }
+    if (stratum() == 0) {
+      // kiss-o'-death packet, the kiss code is in the reference id
+      if (memcmp(refid(), "RATE", 4) == 0) {
+	return 10;
+      }
+      if ((memcmp(refid(), "DENY", 4) == 0) ||
+	  (memcmp(refid(), "RSTR", 4) == 0)) {
+	return 11;
+      }
+      return 8;
+    }
+    if ((stratum() > 15) || (leap() == 3)) {
+      return 8;
+    }
+    if (((mode == NTP_PACKET_VIEW_MODE_SERVER) &&
+	 is_zero(NTP_PACKET_VIEW_REC)) || is_zero(NTP_PACKET_VIEW_XMT)) {
+      return 7;
+    }
+    return 0;
+  }
+
+ private:
+  const uint8_t *_data;
+
+  uint32_t get32(uint8_t offset) const {
+    const uint8_t *p = _data + offset;
+    return (((uint32_t) p[0]) << 24) | (((uint32_t) p[1]) << 16) |
+      (((uint32_t) p[2]) << 8) | ((uint32_t) p[3]);
+  }
+
+  struct ntp_timestamp_format_struct timestamp(uint8_t offset) const {
+    struct ntp_timestamp_format_struct t;
+    t.seconds = get32(offset);
+    t.fraction = get32(offset + 4);
+    return t;
+  }
+
+  bool is_zero(uint8_t offset) const {
+    return (get32(offset) | get32(offset + 4)) == 0;
+  }
+};
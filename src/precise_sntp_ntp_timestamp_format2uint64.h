@@ -0,0 +1,9 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+*/
+
+#pragma once
+
+#define ntp_timestamp_format2uint64(x) \
+  ((((uint64_t) x.seconds) << 32) + x.fraction)
@@ -0,0 +1,180 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  For more information look at precise_sntp_server.h and the README.md.
+*/
+
+#include <precise_sntp_server.h>
+
+#include <precise_sntp_ntp_packet_view.h>
+
+#define NTP_SERVER_MAXDIST (((uint64_t) 3) << 31) // 1.5 s
+#define NTP_SERVER_MAXSTRAT 16 // not synchronized
+
+/*
+  converts a duration in units of 2^-32 seconds to the ntp short format
+  (network byte order)
+*/
+static void duration2short(uint64_t duration, uint8_t *p) {
+  duration >>= 16;
+  const uint32_t v = (duration > 0xFFFFFFFFULL) ?
+    0xFFFFFFFFUL : (uint32_t) duration;
+  p[0] = (uint8_t) (v >> 24);
+  p[1] = (uint8_t) (v >> 16);
+  p[2] = (uint8_t) (v >> 8);
+  p[3] = (uint8_t) v;
+}
+
+/*
+  writes a timestamp in network byte order independent of the host (as
+  decoded by precise_sntp_ntp_packet_view)
+*/
+static void put_timestamp(const struct ntp_timestamp_format_struct &t,
+			  uint8_t *p) {
+  for (uint8_t i = 0; i < 4; i++) {
+    p[i] = (uint8_t) (t.seconds >> (24 - 8 * i));
+    p[4 + i] = (uint8_t) (t.fraction >> (24 - 8 * i));
+  }
+}
+
+precise_sntp_server::precise_sntp_server(UDP &udp, precise_sntp &sntp) {
+  _udp = &udp;
+  _sntp = &sntp;
+  memset(_header, 0, sizeof(_header));
+  memset(&_statistics, 0, sizeof(struct precise_sntp_server_statistics));
+}
+
+bool precise_sntp_server::begin(uint16_t port) {
+  return _udp->begin(port) == 1;
+}
+
+void precise_sntp_server::set_rate_limit(uint16_t min_interval) {
+  _min_interval = min_interval;
+}
+
+struct precise_sntp_server_statistics precise_sntp_server::get_statistics() {
+  return _statistics;
+}
+
+/*
+  Prepares the fields of the answer, which are equal for all requests:
+  leap indicator, stratum, precision, root delay, root dispersion,
+  reference id and reference timestamp.
+*/
+void precise_sntp_server::prepare_header() {
+  const uint8_t stratum = _sntp->get_stratum();
+  const uint64_t rootdelay = _sntp->get_root_delay();
+  // the error bound is large (16 s) as long as the clock was only set by
+  // a transmit timestamp or stepped and the clock filter is empty
+  const uint64_t distance = _sntp->tget_epoch_with_error().error;
+  const uint64_t rootdisp = (distance > (rootdelay >> 1)) ?
+    distance - (rootdelay >> 1) : 0;
+  // not synchronized: never answered, no filtered sample yet or the error
+  // bound grew too large
+  const bool synchronized = (stratum > 0) &&
+    (stratum + 1 < NTP_SERVER_MAXSTRAT) && (distance < NTP_SERVER_MAXDIST);
+  const uint8_t leap = synchronized ? _sntp->get_leap_indicator() : 3;
+  _header[0] = (uint8_t) ((leap << 6) | (4 << 3) | 4); // version 4, server
+  _header[1] = synchronized ? stratum + 1 : NTP_SERVER_MAXSTRAT;
+  _header[2] = 0; // poll, copied from the request
+  _header[3] = (uint8_t) _sntp->get_precision();
+  duration2short(rootdelay, _header + NTP_PACKET_VIEW_ROOTDELAY);
+  duration2short(rootdisp, _header + NTP_PACKET_VIEW_ROOTDISP);
+  const uint32_t refid = _sntp->get_reference_id();
+  _header[NTP_PACKET_VIEW_REFID] = (uint8_t) (refid >> 24);
+  _header[NTP_PACKET_VIEW_REFID + 1] = (uint8_t) (refid >> 16);
+  _header[NTP_PACKET_VIEW_REFID + 2] = (uint8_t) (refid >> 8);
+  _header[NTP_PACKET_VIEW_REFID + 3] = (uint8_t) refid;
+  if (stratum > 0) {
+    // local clock at the last correction
+    const struct ntp_timestamp_format_struct now = _sntp->get_local_clock();
+    const uint64_t age =
+      ((uint64_t) (millis() - _sntp->get_last_update())) * 4294967ULL;
+    const uint64_t reftime =
+      ((((uint64_t) now.seconds) << 32) | now.fraction) - age;
+    struct ntp_timestamp_format_struct t;
+    t.seconds = (uint32_t) (reftime >> 32);
+    t.fraction = (uint32_t) reftime;
+    put_timestamp(t, _header + NTP_PACKET_VIEW_REFTIME);
+  }
+}
+
+/*
+  returns true, if the client ip asked faster than the rate limit
+*/
+bool precise_sntp_server::rate_limited(IPAddress ip) {
+  const unsigned long now = millis();
+  uint8_t oldest = 0;
+  for (uint8_t i = 0; i < _number_of_clients; i++) {
+    if (_clients[i].ip == ip) {
+      const bool limited = (now - _clients[i].last < _min_interval);
+      _clients[i].last = now;
+      return limited;
+    }
+    if (now - _clients[i].last > now - _clients[oldest].last) {
+      oldest = i;
+    }
+  }
+  // a new client replaces the one not seen for the longest time
+  const uint8_t i = (_number_of_clients < PRECISE_SNTP_SERVER_CLIENTS) ?
+    _number_of_clients++ : oldest;
+  _clients[i].ip = ip;
+  _clients[i].last = now;
+  return false;
+}
+
+uint8_t precise_sntp_server::service() {
+  uint8_t answers = 0;
+  bool prepared = false;
+  for (uint8_t n = 0; n < PRECISE_SNTP_SERVER_BURST; n++) {
+    const int size = _udp->parsePacket();
+    if (size <= 0) {
+      break;
+    }
+    // receive timestamp as early as possible
+    const struct ntp_timestamp_format_struct rec = _sntp->get_local_clock();
+    _statistics.requests++;
+    if ((size < NTP_PACKET_VIEW_SIZE) ||
+	(_udp->read(_packet, NTP_PACKET_VIEW_SIZE) != NTP_PACKET_VIEW_SIZE)) {
+      _statistics.bogus++;
+      continue;
+    }
+    const uint8_t version = (_packet[0] >> 3) & 0x07;
+    if (((_packet[0] & 0x07) != 3) || (version < 1) || (version > 4)) {
+      // only client requests (mode 3) are answered
+      _statistics.bogus++;
+      continue;
+    }
+    if (!prepared) {
+      prepare_header();
+      prepared = true;
+    }
+    // build the answer in place byte by byte: the transmit timestamp of
+    // the request is the origin timestamp, the poll exponent is kept
+    const uint8_t poll = _packet[2];
+    memcpy(_packet + NTP_PACKET_VIEW_ORG, _packet + NTP_PACKET_VIEW_XMT, 8);
+    memcpy(_packet, _header, sizeof(_header));
+    _packet[0] = (uint8_t) ((_header[0] & 0xC7) | (version << 3));
+    _packet[2] = poll;
+    if ((_min_interval > 0) && rate_limited(_udp->remoteIP())) {
+      // kiss-o'-death packet
+      _packet[0] |= 0xC0;
+      _packet[1] = 0;
+      memcpy(_packet + NTP_PACKET_VIEW_REFID, "RATE", 4);
+      _statistics.rate_limited++;
+    }
+    put_timestamp(rec, _packet + NTP_PACKET_VIEW_REC);
+    if (_udp->beginPacket(_udp->remoteIP(), _udp->remotePort()) != 1) {
+      continue;
+    }
+    // transmit timestamp as late as possible
+    put_timestamp(_sntp->get_local_clock(), _packet + NTP_PACKET_VIEW_XMT);
+    _udp->write(_packet, NTP_PACKET_VIEW_SIZE);
+    if (_udp->endPacket() == 1) {
+      _statistics.answers++;
+      answers++;
+    }
+  }
+  return answers;
+}
@@ -0,0 +1,120 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Simple ntp server (SNTPv4, RFC 4330 section 6) serving the local clock
+  of a precise_sntp client, e. g. a gateway serving the time to many
+  sensors in a local network.
+
+  The server answers with stratum (stratum of the system peer + 1).
+  The answer is built in place in the buffer of the request byte by byte
+  in network byte order (independent of the host): no allocations and no
+  further copies. The static fields of the header are prepared once per
+  service() call. The receive timestamp is taken directly after
+  parsePacket() and the transmit timestamp directly before write().
+
+  The server needs its own UDP instance (e. g. a second EthernetUDP),
+  since the client uses another local port.
+
+  Example:
+
+  #include <EthernetUdp.h>
+  #include <precise_sntp.h>
+  #include <precise_sntp_server.h>
+  EthernetUDP udp;
+  EthernetUDP server_udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  precise_sntp_server server(server_udp, sntp);
+  void setup() {
+    server.begin();
+  }
+  void loop() {
+    sntp.update_async();
+    server.service();
+  }
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <Udp.h>
+
+#include <precise_sntp.h>
+#include <precise_sntp_ntp_packet_view.h>
+
+// maximal number of requests answered by one call of service()
+#ifndef PRECISE_SNTP_SERVER_BURST
+#define PRECISE_SNTP_SERVER_BURST 8
+#endif
+
+// number of clients remembered for the rate limit
+#ifndef PRECISE_SNTP_SERVER_CLIENTS
+#define PRECISE_SNTP_SERVER_CLIENTS 16
+#endif
+
+struct precise_sntp_server_statistics {
+  uint32_t requests; // packets received
+  uint32_t answers; // answers sent (including kiss-o'-death packets)
+  uint32_t rate_limited; // answers with the kiss code RATE
+  uint32_t bogus; // packets which are no client request
+};
+
+struct precise_sntp_server_client {
+  IPAddress ip;
+  unsigned long last; // millis() of the last request
+};
+
+class precise_sntp_server {
+ public:
+  /*
+    The server serves the local clock of sntp using udp.
+  */
+  precise_sntp_server(UDP &udp, precise_sntp &sntp);
+
+  /*
+    Opens the port (default 123) for the requests.
+
+    returns true on success
+  */
+  bool begin(uint16_t port = 123);
+
+  /*
+    Answers the waiting requests, at most PRECISE_SNTP_SERVER_BURST.
+    Call it as often as possible (e. g. in every loop()).
+
+    If the local clock is not synchronized (no filtered sample yet or its
+    error bound, see precise_sntp::tget_epoch_with_error(), exceeds 1.5 s),
+    the answer has the leap indicator 3 (alarm) and stratum 16, so clients
+    do not use it. The root dispersion is derived from the error bound.
+
+    returns the number of answers sent
+  */
+  uint8_t service();
+
+  /*
+    Set the minimal interval in milliseconds between two requests of the
+    same client. Faster requests are answered by a kiss-o'-death packet
+    with the kiss code RATE. 0 (default) disables the rate limit.
+    PRECISE_SNTP_SERVER_CLIENTS clients are remembered.
+  */
+  void set_rate_limit(uint16_t min_interval);
+
+  /*
+    Returns the counters of the server.
+  */
+  struct precise_sntp_server_statistics get_statistics();
+
+ private:
+  UDP* _udp;
+  precise_sntp* _sntp;
+  uint8_t _packet[NTP_PACKET_VIEW_SIZE]; // request and answer
+  // prepared header (up to the reference timestamp, network byte order)
+  uint8_t _header[NTP_PACKET_VIEW_ORG];
+  uint16_t _min_interval = 0; // milliseconds
+  struct precise_sntp_server_client _clients[PRECISE_SNTP_SERVER_CLIENTS];
+  uint8_t _number_of_clients = 0;
+  struct precise_sntp_server_statistics _statistics;
+
+  void prepare_header();
+  bool rate_limited(IPAddress ip);
+};
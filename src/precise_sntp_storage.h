@@ -0,0 +1,66 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Interface of a non-volatile storage for the state of precise_sntp
+  (see precise_sntp::save_state() and precise_sntp::load_state()), e. g.
+  EEPROM or flash on a board or a file on a host (see
+  extras/posix/posix_file_storage.h).
+
+  Example (SAMD with the FlashStorage library, the flash wears out, so save
+  the state rarely, e. g. once a day):
+
+  #include <FlashStorage.h>
+  #include <string.h>
+  #include <precise_sntp.h>
+  #include <precise_sntp_storage.h>
+  struct state_block {
+    uint8_t data[PRECISE_SNTP_STATE_SIZE];
+  };
+  FlashStorage(state_flash, struct state_block);
+  class flash_storage : public precise_sntp_storage {
+   public:
+    bool read(uint8_t *buffer, size_t size) {
+      if (size > PRECISE_SNTP_STATE_SIZE) {
+        return false;
+      }
+      const struct state_block block = state_flash.read();
+      memcpy(buffer, block.data, size);
+      return true;
+    }
+    bool write(const uint8_t *buffer, size_t size) {
+      if (size > PRECISE_SNTP_STATE_SIZE) {
+        return false;
+      }
+      struct state_block block;
+      memcpy(block.data, buffer, size);
+      state_flash.write(block);
+      return true;
+    }
+  };
+
+  An erased flash is rejected by the CRC of the state (see
+  precise_sntp::import_state()).
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class precise_sntp_storage {
+ public:
+  /*
+    Reads size bytes (the state saved by the last write()).
+
+    returns false on error
+  */
+  virtual bool read(uint8_t *buffer, size_t size) = 0;
+
+  /*
+    Writes size bytes, they have to survive a reboot.
+
+    returns false on error
+  */
+  virtual bool write(const uint8_t *buffer, size_t size) = 0;
+};
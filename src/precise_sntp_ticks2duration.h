@@ -0,0 +1,42 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Converts a number of ticks of the local timebase (millis() or micros())
+  to a duration in units of 2^-32 seconds (ntp timestamp format).
+
+  No division is done at runtime (a 64 bit division is a slow software
+  routine on e. g. Cortex-M0+). The duration of one tick 2^32/ticks_per_second
+  is precomputed as integer part and fraction (in units of 2^-32) and
+  the conversion is done by multiplications and shifts.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// integer part of 2^32/tps (constant expression for constant tps)
+#define PRECISE_SNTP_DURATION_PER_TICK_INT(tps) \
+  ((uint32_t) ((((uint64_t) 1) << 32) / (tps)))
+
+// fraction of 2^32/tps in units of 2^-32 (rounded)
+#define PRECISE_SNTP_DURATION_PER_TICK_FRAC(tps) \
+  ((uint32_t) ((((((((uint64_t) 1) << 32) % (tps)) << 32)) + (tps) / 2) / \
+	       (tps)))
+
+/*
+  Converts ticks to units of 2^-32 seconds using the precomputed duration
+  per tick (see PRECISE_SNTP_DURATION_PER_TICK_INT and
+  PRECISE_SNTP_DURATION_PER_TICK_FRAC).
+
+  The result is rounded to the nearest value. The error is at most
+  1 unit (2^-32 s) for ticks < 2^32.
+*/
+static inline uint64_t precise_sntp_ticks2duration(uint64_t ticks,
+						   uint32_t per_tick_int,
+						   uint32_t per_tick_frac) {
+  const uint32_t high = (uint32_t) (ticks >> 32);
+  const uint32_t low = (uint32_t) ticks;
+  return ticks * per_tick_int + ((uint64_t) high) * per_tick_frac +
+    ((((uint64_t) low) * per_tick_frac + 0x80000000UL) >> 32);
+}
@@ -0,0 +1,25 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Small pseudo random number generator (xorshift32 by G. Marsaglia),
+  e. g. used for the opaque transmit timestamp of the requests.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+  advances the state and returns the next pseudo random number
+
+  The state must not be 0.
+*/
+static inline uint32_t precise_sntp_xorshift32(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
@@ -0,0 +1,125 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Tests of the broadcast client mode (begin_broadcast()) using the
+  simulated ntp server in extras/ntp_server_simulator.h.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp.h>
+#include "../extras/ntp_server_simulator.h"
+
+#define UNITS_PER_MS 4294967.296
+
+unittest_setup() {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+}
+
+/*
+  lets the server ip broadcast every period_us for duration_us and calls
+  update_async() in between, returns the number of successful corrections
+*/
+static uint16_t listen(ntp_server_simulator &udp, precise_sntp &sntp,
+		       IPAddress ip, unsigned long period_us,
+		       unsigned long duration_us) {
+  uint16_t corrections = 0;
+  for (unsigned long t = 0; t < duration_us; t += period_us) {
+    udp.broadcast(ip);
+    // like a busy loop() shortly after the broadcast, later less often
+    for (unsigned long s = 0; s < period_us;) {
+      const unsigned long step = (s < 10000) ? 100 : 10000;
+      udp.advance(step);
+      s += step;
+      if (sntp.update_async() == 0) {
+	corrections++;
+      }
+    }
+  }
+  return corrections;
+}
+
+unittest(test_calibration) {
+  ntp_server_simulator udp;
+  udp.parameter.latency_up_us = 3000;
+  udp.parameter.latency_down_us = 3000;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertTrue(sntp.begin_broadcast());
+  // round-trip delay of about 6 ms
+  const double delay = ((double) sntp.get_delay()) / UNITS_PER_MS;
+  assertMore(delay, 5.5);
+  assertLess(delay, 7.5);
+  // no packet waiting
+  const uint8_t ret = sntp.update_async();
+  assertEqual(1, ret);
+}
+
+unittest(test_calibration_fails) {
+  ntp_server_simulator udp;
+  udp.parameter.silent = true;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertFalse(sntp.begin_broadcast());
+  udp.fail_begin = true;
+  udp.parameter.silent = false;
+  assertFalse(sntp.begin_broadcast());
+}
+
+unittest(test_only_listen) {
+  ntp_server_simulator udp;
+  udp.parameter.latency_up_us = 2000;
+  udp.parameter.latency_down_us = 2000;
+  udp.parameter.drift_ppm = 50.0;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertTrue(sntp.begin_broadcast());
+  const uint32_t sent = udp.packets_sent;
+  // 1 hour with a broadcast every 64 s
+  const uint16_t corrections =
+    listen(udp, sntp, IPAddress(192, 168, 178, 1), 64000000UL, 3600000000UL);
+  assertMore(corrections, 50);
+  // no request sent after the calibration
+  assertEqual(sent, udp.packets_sent);
+  const double error =
+    ((double) udp.clock_error(sntp.get_local_clock())) / UNITS_PER_MS;
+  assertLess(fabs(error), 1.5);
+  // the frequency error of the local oscillator is learned
+  assertLess(sntp.get_frequency(), -4295 * 45);
+  assertMore(sntp.get_frequency(), -4295 * 55);
+}
+
+unittest(test_unknown_sender) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertTrue(sntp.begin_broadcast());
+  udp.broadcast(IPAddress(192, 168, 178, 2));
+  udp.advance(10000);
+  uint8_t ret = sntp.update_async();
+  assertEqual(7, ret);
+  // an answer (mode 4) is no broadcast packet
+  assertEqual(0, udp.beginPacket(IPAddress(192, 168, 178, 1), 123) - 1);
+  assertEqual(0, udp.endPacket() - 1);
+  udp.advance(10000);
+  ret = sntp.update_async();
+  assertEqual(7, ret);
+  // a not synchronized server is rejected
+  udp.server(IPAddress(192, 168, 178, 1)).leap = 3;
+  udp.broadcast(IPAddress(192, 168, 178, 1));
+  udp.advance(10000);
+  ret = sntp.update_async();
+  assertEqual(8, ret);
+}
+
+unittest(test_end_broadcast) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertTrue(sntp.begin_broadcast());
+  sntp.end_broadcast();
+  const uint32_t sent = udp.packets_sent;
+  const uint8_t ret = sntp.force_update();
+  assertEqual(0, ret);
+  assertEqual(sent + 1, udp.packets_sent);
+}
+
+unittest_main()
@@ -0,0 +1,152 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Tests of the history of the clock corrections
+  (src/precise_sntp_clock_history.h) and of convert_past_ticks() using
+  the simulated ntp server in extras/ntp_server_simulator.h.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp.h>
+#include <precise_sntp_clock_history.h>
+#include "../extras/ntp_server_simulator.h"
+
+#define UNITS_PER_MS 4294967.296
+
+unittest_setup() {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+}
+
+static uint64_t as_uint64(struct ntp_timestamp_format_struct t) {
+  return (((uint64_t) t.seconds) << 32) + t.fraction;
+}
+
+static unsigned long ticks() {
+  return PRECISE_SNTP_TICKS();
+}
+
+/*
+  difference a - b in ms
+*/
+static double diff_ms(uint64_t a, uint64_t b) {
+  return ((double) (int64_t) (a - b)) / UNITS_PER_MS;
+}
+
+unittest(test_find) {
+  struct precise_sntp_clock_history h = {};
+  assertTrue(precise_sntp_clock_history_find(&h, 100) == NULL);
+  assertTrue(precise_sntp_clock_history_newest(&h) == NULL);
+  for (uint8_t i = 1; i <= 3; i++) {
+    precise_sntp_clock_history_add(&h)->ticks = 100 * i;
+  }
+  assertEqual(3, h.count);
+  assertEqual(300, precise_sntp_clock_history_newest(&h)->ticks);
+  assertEqual(100, precise_sntp_clock_history_find(&h, 50)->ticks);
+  assertEqual(100, precise_sntp_clock_history_find(&h, 100)->ticks);
+  assertEqual(100, precise_sntp_clock_history_find(&h, 199)->ticks);
+  assertEqual(200, precise_sntp_clock_history_find(&h, 200)->ticks);
+  assertEqual(300, precise_sntp_clock_history_find(&h, 1000)->ticks);
+}
+
+unittest(test_ring) {
+  struct precise_sntp_clock_history h = {};
+  for (uint8_t i = 1; i <= PRECISE_SNTP_HISTORY + 3; i++) {
+    precise_sntp_clock_history_add(&h)->ticks = 100 * i;
+  }
+  // the oldest 3 segments are replaced
+  assertEqual(PRECISE_SNTP_HISTORY, h.count);
+  assertEqual(400, precise_sntp_clock_history_at(&h, 0)->ticks);
+  assertEqual(100 * (PRECISE_SNTP_HISTORY + 3),
+	      precise_sntp_clock_history_newest(&h)->ticks);
+  for (uint8_t i = 4; i <= PRECISE_SNTP_HISTORY + 3; i++) {
+    assertEqual(100 * i,
+		precise_sntp_clock_history_find(&h, 100 * i + 50)->ticks);
+  }
+  assertEqual(400, precise_sntp_clock_history_find(&h, 100)->ticks);
+}
+
+unittest(test_step) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(0, sntp.update());
+  udp.advance(1000000);
+  // an event and the time of the local clock at the event
+  const unsigned long event = ticks();
+  const uint64_t event_clock = as_uint64(sntp.get_local_clock());
+  udp.advance(5000000);
+  // the server jumps 100 ms ahead and the clock is stepped
+  udp.parameter.offset_us = 100000;
+  assertEqual(0, sntp.force_update());
+  udp.advance(5000000);
+  struct ntp_timestamp_format_struct now;
+  sntp.convert_ticks(&event, &now, 1);
+  struct ntp_timestamp_format_struct past;
+  sntp.convert_past_ticks(&event, &past, 1);
+  // the actual correction is wrong for the event, the past one is right
+  assertMore(diff_ms(as_uint64(now), event_clock), 99.0);
+  assertLess(fabs(diff_ms(as_uint64(past), event_clock)), 0.01);
+  // ticks after the step are converted as by convert_ticks()
+  const unsigned long later = ticks();
+  sntp.convert_ticks(&later, &now, 1);
+  sntp.convert_past_ticks(&later, &past, 1);
+  assertLess(fabs(diff_ms(as_uint64(now), as_uint64(past))), 0.01);
+  // epoch
+  struct timestamp_format epoch;
+  sntp.convert_past_ticks_epoch(&event, &epoch, 1);
+  assertEqual((uint32_t) (event_clock >> 32) - 2208988800UL, epoch.seconds);
+}
+
+unittest(test_slew) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_slew_rate(500);
+  assertEqual(0, sntp.update());
+  // the server jumps 20 ms ahead: 40 seconds to slew it with 500 ppm
+  udp.parameter.offset_us = 20000;
+  assertEqual(0, sntp.force_update());
+  unsigned long events[5];
+  uint64_t events_clock[5];
+  for (uint8_t i = 0; i < 5; i++) {
+    udp.advance(10000000);
+    events[i] = ticks();
+    events_clock[i] = as_uint64(sntp.get_local_clock());
+  }
+  udp.parameter.offset_us = -50000;
+  assertEqual(0, sntp.force_update());
+  struct ntp_timestamp_format_struct past[5];
+  sntp.convert_past_ticks(events, past, 5);
+  for (uint8_t i = 0; i < 5; i++) {
+    assertLess(fabs(diff_ms(as_uint64(past[i]), events_clock[i])), 0.01);
+  }
+}
+
+unittest(test_many_corrections) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(0, sntp.update());
+  const uint8_t n = PRECISE_SNTP_HISTORY + 4;
+  unsigned long events[n];
+  uint64_t events_clock[n];
+  for (uint8_t i = 0; i < n; i++) {
+    udp.advance(2000000);
+    events[i] = ticks();
+    events_clock[i] = as_uint64(sntp.get_local_clock());
+    // every correction steps the clock by 10 ms
+    udp.parameter.offset_us += 10000;
+    assertEqual(0, sntp.force_update());
+  }
+  struct ntp_timestamp_format_struct past[n];
+  sntp.convert_past_ticks(events, past, n);
+  // the events of the kept corrections are converted as they happened
+  for (uint8_t i = n - PRECISE_SNTP_HISTORY + 1; i < n; i++) {
+    assertLess(fabs(diff_ms(as_uint64(past[i]), events_clock[i])), 0.01);
+  }
+  // older ones are extrapolated from the oldest kept correction
+  assertMore(diff_ms(as_uint64(past[0]), events_clock[0]), 9.0);
+}
+
+unittest_main()
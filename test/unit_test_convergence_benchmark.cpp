@@ -0,0 +1,149 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Convergence benchmark against the simulated ntp server in
+  extras/ntp_server_simulator.h.
+
+  For some network scenarios the strategies update(),
+  update_adapt_poll_period(), force_update_iburst() and begin_iburst()
+  with update_async() are run over
+  simulated days. The loop calls the strategy every simulated second.
+  The time to sync (error below SYNC_THRESHOLD_MS), the root mean square
+  and maximal error after the sync and the number of packets sent are
+  printed as a table. The asserts only catch large regressions.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <stdio.h>
+
+#include <precise_sntp.h>
+#include "../extras/ntp_server_simulator.h"
+
+#define UNITS_PER_MS 4294967.296
+#define SYNC_THRESHOLD_MS 5.0
+#define SIMULATED_DAYS 2
+
+enum strategy {
+  STRATEGY_UPDATE,
+  STRATEGY_ADAPT,
+  STRATEGY_IBURST_ADAPT,
+  STRATEGY_ASYNC_IBURST_ADAPT
+};
+
+struct convergence_result {
+  double time_to_sync; // seconds, negative if never synchronized
+  double rms; // milliseconds
+  double max; // milliseconds
+  uint32_t packets;
+};
+
+static struct convergence_result
+run_scenario(const char *name, struct ntp_server_simulator_parameter p,
+	     enum strategy s) {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+  ntp_server_simulator udp(3900000000UL, 4711);
+  udp.parameter = p;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_poll_exponent_range(6, 10);
+  struct convergence_result result = {-1.0, 0.0, 0.0, 0};
+  double sum = 0.0;
+  uint32_t n = 0;
+  if (s == STRATEGY_IBURST_ADAPT) {
+    sntp.force_update_iburst(8, 2000);
+  } else if (s == STRATEGY_ASYNC_IBURST_ADAPT) {
+    sntp.begin_iburst();
+  }
+  // the time to sync does not count the blocking force_update_iburst()
+  // (about 14 s), but the asynchronous begin_iburst()
+  const unsigned long start = micros();
+  const uint32_t seconds = SIMULATED_DAYS * 86400UL;
+  for (uint32_t i = 0; i < seconds; i++) {
+    if (s == STRATEGY_UPDATE) {
+      sntp.update();
+    } else if (s == STRATEGY_ASYNC_IBURST_ADAPT) {
+      while (sntp.update_async(true) == PRECISE_SNTP_POLL_PENDING) {
+	// a real loop() would do other work between the calls
+      }
+    } else {
+      sntp.update_adapt_poll_period();
+    }
+    const double error =
+      ((double) udp.clock_error(sntp.get_local_clock())) / UNITS_PER_MS;
+    if ((result.time_to_sync < 0) && (fabs(error) < SYNC_THRESHOLD_MS)) {
+      result.time_to_sync = ((double) (micros() - start)) / 1e6;
+    }
+    if (result.time_to_sync >= 0) {
+      sum += error * error;
+      n++;
+      if (fabs(error) > result.max) {
+	result.max = fabs(error);
+      }
+    }
+    udp.advance(1000000);
+  }
+  result.rms = (n > 0) ? sqrt(sum / n) : 0.0;
+  result.packets = udp.packets_sent;
+  const char *strategy_name[] = {"update", "adapt", "iburst+adapt",
+				 "async+adapt"};
+  printf("%-6s %-13s %10.1f %10.3f %10.3f %8u\n", name, strategy_name[s],
+	 result.time_to_sync, result.rms, result.max,
+	 (unsigned int) result.packets);
+  return result;
+}
+
+static void print_header() {
+  printf("%-6s %-13s %10s %10s %10s %8s\n", "net", "strategy",
+	 "sync [s]", "rms [ms]", "max [ms]", "packets");
+}
+
+unittest(benchmark_lan) {
+  struct ntp_server_simulator_parameter p;
+  p.latency_up_us = 300;
+  p.latency_down_us = 300;
+  p.jitter_us = 200;
+  p.drift_ppm = 20.0;
+  print_header();
+  for (uint8_t s = STRATEGY_UPDATE; s <= STRATEGY_ASYNC_IBURST_ADAPT; s++) {
+    const struct convergence_result r = run_scenario("lan", p, (strategy) s);
+    assertMoreOrEqual(r.time_to_sync, 0.0);
+    assertLess(r.time_to_sync, 10.0);
+    assertLess(r.max, 5.0);
+  }
+}
+
+unittest(benchmark_wan) {
+  struct ntp_server_simulator_parameter p;
+  p.latency_up_us = 8000;
+  p.latency_down_us = 15000;
+  p.jitter_us = 5000;
+  p.drift_ppm = -40.0;
+  p.loss_percent = 2;
+  print_header();
+  for (uint8_t s = STRATEGY_UPDATE; s <= STRATEGY_ASYNC_IBURST_ADAPT; s++) {
+    const struct convergence_result r = run_scenario("wan", p, (strategy) s);
+    assertMoreOrEqual(r.time_to_sync, 0.0);
+    assertLess(r.max, 30.0);
+  }
+}
+
+unittest(benchmark_lossy) {
+  struct ntp_server_simulator_parameter p;
+  p.latency_up_us = 2000;
+  p.latency_down_us = 2000;
+  p.jitter_us = 1000;
+  p.drift_ppm = 50.0;
+  p.loss_percent = 20;
+  print_header();
+  for (uint8_t s = STRATEGY_UPDATE; s <= STRATEGY_ASYNC_IBURST_ADAPT; s++) {
+    const struct convergence_result r =
+      run_scenario("lossy", p, (strategy) s);
+    assertMoreOrEqual(r.time_to_sync, 0.0);
+    assertLess(r.max, 20.0);
+  }
+}
+
+unittest_main()
@@ -0,0 +1,102 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp.h>
+#include <precise_sntp_convert_ticks.h>
+#include <precise_sntp_ticks2duration.h>
+#include "../extras/ntp_server_simulator.h"
+
+#define CAPTURED 200
+
+static uint64_t as_uint64(struct ntp_timestamp_format_struct t) {
+  return (((uint64_t) t.seconds) << 32) + t.fraction;
+}
+
+static uint64_t difference(uint64_t a, uint64_t b) {
+  return (a > b) ? (a - b) : (b - a);
+}
+
+unittest_setup() {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+}
+
+unittest(test_convert_tick) {
+  struct precise_sntp_convert_ticks_parameter p;
+  p.now_ticks = 5000;
+  p.elapsed = ((int64_t) 4) << 32; // 4 seconds since the clock update
+  p.clock = ((uint64_t) 3900000000UL) << 32;
+  p.frequency = 0;
+  p.slew_rate = 0;
+  p.slew = 0;
+  p.per_tick_int = PRECISE_SNTP_DURATION_PER_TICK_INT(1000);
+  p.per_tick_frac = PRECISE_SNTP_DURATION_PER_TICK_FRAC(1000);
+  // now
+  assertTrue(precise_sntp_convert_tick(&p, 5000) == p.clock + p.elapsed);
+  // 1.5 s before now
+  assertTrue(precise_sntp_convert_tick(&p, 3500) ==
+	     p.clock + (((uint64_t) 5) << 31));
+  // before the clock update
+  assertTrue(precise_sntp_convert_tick(&p, 0) ==
+	     p.clock - (((uint64_t) 1) << 32));
+  // overflow of the ticks between the tick and now
+  p.now_ticks = 1000;
+  assertTrue(precise_sntp_convert_tick(&p, (unsigned long) -1000) ==
+	     p.clock + (((uint64_t) 2) << 32));
+  // frequency correction of 1000 ppm
+  p.now_ticks = 5000;
+  p.frequency = 4294967;
+  assertLessOrEqual(difference(precise_sntp_convert_tick(&p, 5000),
+			       p.clock + p.elapsed + (p.elapsed / 1000)), 2);
+  // slew of 10 ms with 500 ppm, done after 20 s
+  p.frequency = 0;
+  p.slew_rate = 2147484;
+  p.slew = -42949673;
+  assertLessOrEqual(difference(precise_sntp_convert_tick(&p, 5000),
+			       p.clock + p.elapsed - (p.elapsed / 2000)), 2);
+  assertTrue(precise_sntp_convert_tick(&p, 0) ==
+	     p.clock - (((uint64_t) 1) << 32));
+  p.now_ticks = 30000;
+  p.elapsed = ((int64_t) 29) << 32;
+  assertTrue(precise_sntp_convert_tick(&p, 30000) ==
+	     p.clock + p.elapsed + p.slew);
+}
+
+unittest(test_convert_ticks_like_get_local_clock) {
+  ntp_server_simulator udp;
+  udp.parameter.drift_ppm = 120.0;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_slew_rate(100);
+  for (uint8_t i = 0; i < 10; i++) {
+    assertEqual(0, sntp.force_update());
+    udp.advance(64000000UL);
+  }
+  // a further correction is slewed while the ticks are captured
+  udp.parameter.offset_us = 3000;
+  assertEqual(0, sntp.force_update());
+  unsigned long ticks[CAPTURED];
+  struct ntp_timestamp_format_struct expected[CAPTURED];
+  for (uint16_t i = 0; i < CAPTURED; i++) {
+    udp.advance(123457);
+    ticks[i] = PRECISE_SNTP_TICKS();
+    expected[i] = sntp.get_local_clock();
+  }
+  udp.advance(5000000UL);
+  struct ntp_timestamp_format_struct clock[CAPTURED];
+  sntp.convert_ticks(ticks, clock, CAPTURED);
+  struct timestamp_format epoch[CAPTURED];
+  sntp.convert_ticks_epoch(ticks, epoch, CAPTURED);
+  for (uint16_t i = 0; i < CAPTURED; i++) {
+    assertLessOrEqual(difference(as_uint64(clock[i]), as_uint64(expected[i])),
+		      2);
+    assertEqual(clock[i].seconds - 2208988800UL, epoch[i].seconds);
+    assertEqual(clock[i].fraction, epoch[i].fraction);
+  }
+}
+
+unittest_main()
@@ -0,0 +1,73 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Benchmark of the batch conversion of captured ticks (convert_ticks() and
+  convert_ticks_epoch()) compared to converting them one by one.
+
+  The conversions per second (cpu time of the host) are printed for a
+  buffer of BENCHMARK_TICKS ticks. The asserts only check, that both ways
+  give the same result.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <stdio.h>
+#include <time.h>
+
+#include <precise_sntp.h>
+#include "../extras/ntp_server_simulator.h"
+
+#define BENCHMARK_TICKS 1000000UL
+
+static unsigned long ticks[BENCHMARK_TICKS];
+static struct ntp_timestamp_format_struct clock_batch[BENCHMARK_TICKS];
+static struct ntp_timestamp_format_struct clock_single[BENCHMARK_TICKS];
+static struct timestamp_format epoch_batch[BENCHMARK_TICKS];
+
+static void print_rate(const char *name, clock_t start) {
+  const double seconds = ((double) (clock() - start)) / CLOCKS_PER_SEC;
+  printf("%-12s %14.0f\n", name,
+	 (seconds > 0) ? BENCHMARK_TICKS / seconds : 0.0);
+}
+
+unittest(benchmark_convert_ticks) {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+  ntp_server_simulator udp;
+  udp.parameter.drift_ppm = 50.0;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_slew_rate(500);
+  for (uint8_t i = 0; i < 4; i++) {
+    assertEqual(0, sntp.force_update());
+    udp.advance(64000000UL);
+  }
+  const unsigned long now = PRECISE_SNTP_TICKS();
+  for (unsigned long i = 0; i < BENCHMARK_TICKS; i++) {
+    ticks[i] = now - (BENCHMARK_TICKS - i) * 7;
+  }
+  printf("%-12s %14s\n", "conversion", "ticks/s");
+  clock_t start = clock();
+  for (unsigned long i = 0; i < BENCHMARK_TICKS; i++) {
+    sntp.convert_ticks(ticks + i, clock_single + i, 1);
+  }
+  print_rate("single", start);
+  start = clock();
+  sntp.convert_ticks(ticks, clock_batch, BENCHMARK_TICKS);
+  print_rate("batch ntp", start);
+  start = clock();
+  sntp.convert_ticks_epoch(ticks, epoch_batch, BENCHMARK_TICKS);
+  print_rate("batch epoch", start);
+  uint32_t differences = 0;
+  for (unsigned long i = 0; i < BENCHMARK_TICKS; i++) {
+    if ((clock_batch[i].seconds != clock_single[i].seconds) ||
+	(clock_batch[i].fraction != clock_single[i].fraction) ||
+	(epoch_batch[i].fraction != clock_single[i].fraction)) {
+      differences++;
+    }
+  }
+  assertEqual(0, differences);
+}
+
+unittest_main()
@@ -0,0 +1,36 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp_crc16.h>
+
+unittest(test_crc16_check_value) {
+  // check value of CRC-16/CCITT-FALSE
+  const uint8_t data[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  assertEqual(0x29B1, precise_sntp_crc16(data, sizeof(data)));
+}
+
+unittest(test_crc16_empty) {
+  assertEqual(0xFFFF, precise_sntp_crc16(NULL, 0));
+}
+
+unittest(test_crc16_detects_bit_errors) {
+  uint8_t data[20];
+  for (uint8_t i = 0; i < sizeof(data); i++) {
+    data[i] = (uint8_t) (i * 37);
+  }
+  const uint16_t crc = precise_sntp_crc16(data, sizeof(data));
+  for (uint8_t i = 0; i < sizeof(data); i++) {
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      data[i] ^= (uint8_t) (1 << bit);
+      assertNotEqual(crc, precise_sntp_crc16(data, sizeof(data)));
+      data[i] ^= (uint8_t) (1 << bit);
+    }
+  }
+}
+
+unittest_main()
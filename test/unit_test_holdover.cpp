@@ -0,0 +1,119 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Tests of the error bound (tget_epoch_with_error()) and of
+  is_synchronized() with a maximal error (set_max_error()) using the
+  simulated ntp server in extras/ntp_server_simulator.h.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp.h>
+#include "../extras/ntp_server_simulator.h"
+
+#define UNITS_PER_MS 4294967.296
+
+unittest_setup() {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+}
+
+/*
+  true error of the local clock in ms
+*/
+static double true_error_ms(ntp_server_simulator &udp, precise_sntp &sntp) {
+  return ((double) udp.clock_error(sntp.get_local_clock())) / UNITS_PER_MS;
+}
+
+/*
+  polls every 64 seconds for n polls
+*/
+static void poll(ntp_server_simulator &udp, precise_sntp &sntp, uint8_t n) {
+  for (uint8_t i = 0; i < n; i++) {
+    sntp.force_update();
+    udp.advance(64000000UL);
+  }
+}
+
+unittest(test_never_set) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  const struct timestamp_with_error_format t = sntp.tget_epoch_with_error();
+  assertTrue(t.error == 0xFFFFFFFFFFFFFFFFULL);
+  sntp.set_max_error(1000);
+  assertFalse(sntp.is_synchronized());
+}
+
+unittest(test_error_bound) {
+  ntp_server_simulator udp;
+  udp.parameter.latency_up_us = 2000;
+  udp.parameter.latency_down_us = 1000;
+  udp.parameter.rootdelay = 65536 / 100; // 10 ms
+  udp.parameter.rootdisp = 65536 / 1000; // 1 ms
+  udp.parameter.drift_ppm = 30.0;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  poll(udp, sntp, 12);
+  const struct timestamp_with_error_format t = sntp.tget_epoch_with_error();
+  const double error = ((double) t.error) / UNITS_PER_MS;
+  // half the root delay, root dispersion and half the delay to the server
+  assertMore(error, 5.0 + 1.0 + 1.5);
+  assertLess(error, 20.0);
+  // the true error is within the bound
+  assertLess(fabs(true_error_ms(udp, sntp)), error);
+  const struct timestamp_format e = sntp.tget_epoch();
+  assertEqual(e.seconds, t.seconds);
+}
+
+unittest(test_holdover) {
+  ntp_server_simulator udp;
+  udp.parameter.drift_ppm = -40.0;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_poll_exponent_range(6, 6);
+  poll(udp, sntp, 30);
+  sntp.set_max_error(100);
+  assertTrue(sntp.is_synchronized());
+  // the servers are lost, the error bound grows
+  udp.parameter.silent = true;
+  double last = 0.0;
+  bool synchronized = true;
+  unsigned long lost_after = 0;
+  for (unsigned long s = 0; s < 4 * 3600; s += 60) {
+    sntp.update_async();
+    udp.advance(60000000UL);
+    const struct timestamp_with_error_format t = sntp.tget_epoch_with_error();
+    const double error = ((double) t.error) / UNITS_PER_MS;
+    assertMore(error, last);
+    last = error;
+    assertLess(fabs(true_error_ms(udp, sntp)), error);
+    if (synchronized && (!sntp.is_synchronized())) {
+      synchronized = false;
+      lost_after = s;
+    }
+  }
+  // the frequency tolerance of 15 ppm gives 100 ms after about 2 hours
+  assertFalse(synchronized);
+  assertMore(lost_after, 3600UL);
+  assertLess(lost_after, 3 * 3600UL);
+  // without a maximal error it is not synchronized after a poll period
+  sntp.set_max_error(0);
+  assertFalse(sntp.is_synchronized());
+}
+
+unittest(test_slew_pending) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_slew_rate(500);
+  poll(udp, sntp, 12);
+  const uint64_t before = sntp.tget_epoch_with_error().error;
+  // the server is 50 ms ahead: the correction is slewed
+  udp.parameter.offset_us = 50000;
+  sntp.force_update();
+  const double error = ((double) sntp.tget_epoch_with_error().error) /
+    UNITS_PER_MS;
+  assertMore(error, 45.0 + before / UNITS_PER_MS);
+  assertLess(fabs(true_error_ms(udp, sntp) - 50.0), error);
+}
+
+unittest_main()
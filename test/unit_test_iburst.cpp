@@ -0,0 +1,129 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Tests of the asynchronous, pipelined iburst (begin_iburst()) against the
+  simulated ntp servers in extras/ntp_server_simulator.h.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp.h>
+#include "../extras/ntp_server_simulator.h"
+
+#define UNITS_PER_MS 4294967.296
+
+unittest_setup() {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+}
+
+/*
+  runs the iburst by calling service() and returns the needed time in us
+*/
+static unsigned long run_iburst(precise_sntp &sntp,
+				unsigned long *longest_call = NULL) {
+  const unsigned long start = micros();
+  uint8_t ret;
+  do {
+    const unsigned long call = micros();
+    ret = sntp.service();
+    if (longest_call && (micros() - call > *longest_call)) {
+      *longest_call = micros() - call;
+    }
+  } while (ret == PRECISE_SNTP_POLL_PENDING);
+  return micros() - start;
+}
+
+unittest(test_iburst_does_not_block) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertTrue(sntp.begin_iburst());
+  assertFalse(sntp.begin_poll());
+  assertEqual(13, sntp.force_update());
+  assertEqual(PRECISE_SNTP_POLL_IBURST, sntp.get_poll_state());
+  struct precise_sntp_iburst_status status = sntp.get_iburst_status();
+  assertTrue(status.running);
+  assertEqual(8, status.requests);
+  assertEqual(PRECISE_SNTP_POLL_PENDING, status.result);
+  unsigned long longest_call = 0;
+  const unsigned long duration = run_iburst(sntp, &longest_call);
+  assertLessOrEqual(longest_call, udp.parameter.poll_step_us);
+  assertLess(duration, 2000000UL);
+  status = sntp.get_iburst_status();
+  assertFalse(status.running);
+  assertEqual(8, status.sent);
+  assertEqual(8, status.valid);
+  assertEqual(0, status.failed);
+  assertEqual(0, status.result);
+  assertTrue(sntp.is_synchronized());
+  const int64_t error = udp.clock_error(sntp.get_local_clock());
+  assertLess(abs(error), (int64_t) (2 * UNITS_PER_MS));
+}
+
+unittest(test_iburst_pipelined) {
+  ntp_server_simulator udp;
+  udp.parameter.latency_up_us = 300000;
+  udp.parameter.latency_down_us = 300000;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertTrue(sntp.begin_iburst(PRECISE_SNTP_IBURST_SLOTS, 100));
+  // sequential requests would need PRECISE_SNTP_IBURST_SLOTS * 600 ms
+  assertLess(run_iburst(sntp), 100000UL * PRECISE_SNTP_IBURST_SLOTS + 700000UL);
+  assertEqual(PRECISE_SNTP_IBURST_SLOTS, sntp.get_iburst_status().valid);
+  assertEqual(0, sntp.get_iburst_status().result);
+}
+
+unittest(test_iburst_lowest_delay) {
+  ntp_server_simulator udp(3900000000UL, 42);
+  // asymmetric jitter: only the replies are randomly delayed
+  udp.parameter.jitter_us = 20000;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertTrue(sntp.begin_iburst());
+  run_iburst(sntp);
+  assertEqual(0, sntp.get_iburst_status().result);
+  const int64_t error = udp.clock_error(sntp.get_local_clock());
+  assertLess(abs(error), (int64_t) (5 * UNITS_PER_MS));
+}
+
+unittest(test_iburst_loss) {
+  ntp_server_simulator udp(3900000000UL, 3);
+  udp.parameter.loss_percent = 40;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertTrue(sntp.begin_iburst());
+  run_iburst(sntp);
+  const struct precise_sntp_iburst_status status = sntp.get_iburst_status();
+  assertEqual(8, status.valid + status.failed);
+  assertMore(status.failed, 0);
+  assertEqual(6, status.last_error);
+  assertEqual(0, status.result);
+  // nothing answers
+  udp.parameter.loss_percent = 100;
+  assertTrue(sntp.begin_iburst(4));
+  run_iburst(sntp);
+  assertEqual(4, sntp.get_iburst_status().failed);
+  assertEqual(6, sntp.get_iburst_status().result);
+}
+
+unittest(test_iburst_several_servers) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.add_server(IPAddress(192, 168, 178, 2));
+  sntp.add_server(IPAddress(192, 168, 178, 3));
+  udp.server(IPAddress(192, 168, 178, 1));
+  udp.server(IPAddress(192, 168, 178, 2));
+  udp.server(IPAddress(192, 168, 178, 3)).latency_up_us = 2000;
+  assertTrue(sntp.begin_iburst(9));
+  while (sntp.update_async() == PRECISE_SNTP_POLL_PENDING) {
+  }
+  assertEqual(0, sntp.get_iburst_status().result);
+  assertEqual(9, sntp.get_iburst_status().valid);
+  assertEqual(3, sntp.get_number_of_survivors());
+  for (uint8_t i = 1; i <= 3; i++) {
+    assertEqual(3, udp.server(IPAddress(192, 168, 178, i)).requests);
+  }
+  const int64_t error = udp.clock_error(sntp.get_local_clock());
+  assertLess(abs(error), (int64_t) (2 * UNITS_PER_MS));
+}
+
+unittest_main()
@@ -0,0 +1,33 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp_isqrt.h>
+
+unittest(test_isqrt64_small) {
+  assertEqual(0, precise_sntp_isqrt64(0));
+  assertEqual(1, precise_sntp_isqrt64(1));
+  assertEqual(1, precise_sntp_isqrt64(3));
+  assertEqual(2, precise_sntp_isqrt64(4));
+  assertEqual(9, precise_sntp_isqrt64(99));
+  assertEqual(10, precise_sntp_isqrt64(100));
+}
+
+unittest(test_isqrt64_large) {
+  uint64_t value = 0xFFFFFFFFFFFFFFFFULL;
+  uint64_t result = 0xFFFFFFFFUL;
+  assertEqual(result, precise_sntp_isqrt64(value));
+  value = 4294967296ULL * 4294967295ULL; // floor(sqrt) is 4294967295
+  result = 4294967295UL;
+  assertEqual(result, precise_sntp_isqrt64(value));
+  value = 1000000007ULL * 1000000007ULL;
+  result = 1000000007UL;
+  assertEqual(result, precise_sntp_isqrt64(value));
+  assertEqual(result - 1, precise_sntp_isqrt64(value - 1));
+}
+
+unittest_main()
@@ -0,0 +1,133 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Tests of the kiss-o'-death packets (RATE, DENY, RSTR), the leap
+  indicator and the synchronization distance announced by the server.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp.h>
+#include "../extras/ntp_server_simulator.h"
+
+#define UNITS_PER_MS 4294967.296
+
+unittest_setup() {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+}
+
+static void set_kiss_code(struct ntp_server_simulator_parameter &p,
+			  const char *code) {
+  p.stratum = 0;
+  memcpy(p.refid, code, 4);
+}
+
+/*
+  calls update_async() every 100 ms for the given seconds,
+  returns the number of requests sent
+*/
+static uint32_t run(ntp_server_simulator &udp, precise_sntp &sntp,
+		    uint32_t seconds) {
+  const uint32_t sent = udp.packets_sent;
+  for (uint32_t i = 0; i < 10 * seconds; i++) {
+    sntp.update_async();
+    udp.advance(100000);
+  }
+  return udp.packets_sent - sent;
+}
+
+unittest(test_rate) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_poll_exponent_range(6, 10);
+  assertEqual(0, sntp.update());
+  set_kiss_code(udp.parameter, "RATE");
+  assertEqual(10, sntp.force_update());
+  // the minimal poll period is raised to 128 s, the next poll waits
+  // at least the half of it
+  uint32_t sent = run(udp, sntp, 63);
+  assertEqual(0, sent);
+  memcpy(udp.parameter.refid, "GPS", 4);
+  udp.parameter.stratum = 2;
+  while (sntp.update_async() != 0) {
+    udp.advance(100000);
+  }
+  // synchronized again, the poll period is 128 s
+  udp.advance(100000);
+  sent = run(udp, sntp, 127);
+  assertEqual(0, sent);
+  sent = run(udp, sntp, 2);
+  assertEqual(1, sent);
+}
+
+unittest(test_deny) {
+  ntp_server_simulator udp;
+  set_kiss_code(udp.server(IPAddress(192, 168, 178, 1)), "DENY");
+  set_kiss_code(udp.server(IPAddress(192, 168, 178, 2)), "RSTR");
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.add_server(IPAddress(192, 168, 178, 2));
+  assertEqual(11, sntp.force_update());
+  assertEqual(2, udp.packets_sent);
+  // the servers are not asked again
+  assertEqual(11, sntp.force_update());
+  const uint32_t sent = run(udp, sntp, 600);
+  assertEqual(0, sent);
+  assertEqual(2, udp.packets_sent);
+}
+
+unittest(test_deny_one_server) {
+  ntp_server_simulator udp;
+  set_kiss_code(udp.server(IPAddress(192, 168, 178, 1)), "DENY");
+  udp.server(IPAddress(192, 168, 178, 2));
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.add_server(IPAddress(192, 168, 178, 2));
+  assertEqual(0, sntp.force_update());
+  assertEqual(0, sntp.force_update());
+  assertEqual(1, sntp.get_system_peer());
+  assertEqual(1, udp.server(IPAddress(192, 168, 178, 1)).requests);
+  assertEqual(2, udp.server(IPAddress(192, 168, 178, 2)).requests);
+}
+
+unittest(test_other_kiss_code) {
+  ntp_server_simulator udp;
+  set_kiss_code(udp.parameter, "INIT");
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(8, sntp.force_update());
+  assertEqual(8, sntp.force_update());
+  assertEqual(2, udp.packets_sent);
+}
+
+unittest(test_leap_indicator) {
+  ntp_server_simulator udp;
+  udp.parameter.leap = 3; // alarm, not synchronized
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(8, sntp.force_update());
+  udp.parameter.leap = 1;
+  assertEqual(0, sntp.force_update());
+  assertEqual(0, sntp.force_update());
+  assertEqual(1, sntp.get_leap_indicator());
+  udp.parameter.leap = 0;
+  assertEqual(0, sntp.force_update());
+  assertEqual(0, sntp.get_leap_indicator());
+}
+
+unittest(test_sync_distance) {
+  ntp_server_simulator udp;
+  udp.parameter.rootdelay = 20 << 16; // 20 s
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(12, sntp.force_update());
+  udp.parameter.rootdelay = 65536 / 10; // 100 ms
+  udp.parameter.rootdisp = 65536 / 20; // 50 ms
+  assertEqual(0, sntp.force_update());
+  assertEqual(0, sntp.force_update());
+  // 50 ms + 50 ms + delay / 2 + dispersion of the clock filter
+  const double distance = ((double) sntp.get_sync_distance()) / UNITS_PER_MS;
+  assertMore(distance, 100.0);
+  sntp.set_max_distance(50);
+  assertEqual(12, sntp.force_update());
+}
+
+unittest_main()
@@ -0,0 +1,57 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp_latch.h>
+
+struct state {
+  uint64_t a;
+  uint32_t b;
+};
+
+unittest(test_latch_write_read) {
+  volatile uint8_t sequence = 0;
+  struct state copies[2];
+  memset(copies, 0, sizeof(copies));
+  struct state value = {0x0123456789ABCDEFULL, 42};
+  precise_sntp_latch_write(&sequence, copies, &value, sizeof(struct state));
+  assertEqual(2, sequence);
+  struct state read;
+  precise_sntp_latch_read(&sequence, copies, &read, sizeof(struct state));
+  assertTrue(read.a == value.a);
+  assertEqual(42UL, read.b);
+  assertTrue(copies[0].a == value.a);
+  assertTrue(copies[1].a == value.a);
+  // the sequence wraps around
+  for (uint16_t i = 0; i < 200; i++) {
+    value.b = i;
+    precise_sntp_latch_write(&sequence, copies, &value, sizeof(struct state));
+    precise_sntp_latch_read(&sequence, copies, &read, sizeof(struct state));
+    assertEqual(i, read.b);
+  }
+}
+
+unittest(test_latch_read_while_writing) {
+  // a reader interrupting the writer uses the copy not written
+  volatile uint8_t sequence = 5; // odd: copy 0 is written
+  struct state copies[2];
+  copies[0].a = 0xFFFFFFFF00000000ULL; // torn
+  copies[0].b = 0;
+  copies[1].a = 7;
+  copies[1].b = 8;
+  struct state read;
+  precise_sntp_latch_read(&sequence, copies, &read, sizeof(struct state));
+  assertTrue(read.a == 7);
+  assertEqual(8UL, read.b);
+  sequence = 6; // even: copy 1 is written
+  copies[0].a = 9;
+  copies[1].a = 0xFFFFFFFF00000000ULL; // torn
+  precise_sntp_latch_read(&sequence, copies, &read, sizeof(struct state));
+  assertTrue(read.a == 9);
+}
+
+unittest_main()
@@ -0,0 +1,90 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Tests of the multi server mode (selection, cluster and combine algorithms)
+  against the simulated ntp servers in extras/ntp_server_simulator.h.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp.h>
+#include "../extras/ntp_server_simulator.h"
+
+#define UNITS_PER_MS 4294967.296
+
+unittest_setup() {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+}
+
+unittest(test_add_server) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(1, sntp.get_number_of_servers());
+  for (uint8_t i = 1; i < PRECISE_SNTP_MAX_SERVERS; i++) {
+    assertTrue(sntp.add_server(IPAddress(192, 168, 178, 1 + i)));
+  }
+  assertFalse(sntp.add_server("pool.ntp.org"));
+  assertEqual(PRECISE_SNTP_MAX_SERVERS, sntp.get_number_of_servers());
+  assertEqual(0, sntp.update());
+  assertEqual(PRECISE_SNTP_MAX_SERVERS, udp.packets_sent);
+}
+
+unittest(test_falseticker_is_discarded) {
+  ntp_server_simulator udp(3900000000UL, 7);
+  udp.parameter.jitter_us = 200;
+  // the first server (used to set the clock initially) is 50 ms off
+  udp.server(IPAddress(192, 168, 178, 1)).offset_us = 50000;
+  udp.server(IPAddress(192, 168, 178, 2));
+  udp.server(IPAddress(192, 168, 178, 3)).latency_down_us = 1500;
+  udp.server(IPAddress(192, 168, 178, 4)).latency_up_us = 1500;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.add_server(IPAddress(192, 168, 178, 2));
+  sntp.add_server(IPAddress(192, 168, 178, 3));
+  sntp.add_server(IPAddress(192, 168, 178, 4));
+  sntp.force_update_iburst(9, 100);
+  for (uint32_t i = 0; i < 3600; i++) {
+    sntp.update();
+    udp.advance(1000000);
+  }
+  assertEqual(0, sntp.force_update());
+  assertEqual(3, sntp.get_number_of_survivors());
+  assertNotEqual(0, sntp.get_system_peer());
+  const int64_t error = udp.clock_error(sntp.get_local_clock());
+  assertLess(abs(error), (int64_t) (2 * UNITS_PER_MS));
+}
+
+unittest(test_no_majority) {
+  ntp_server_simulator udp;
+  udp.server(IPAddress(192, 168, 178, 1));
+  udp.server(IPAddress(192, 168, 178, 2)).offset_us = 100000000; // 100 s
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.add_server(IPAddress(192, 168, 178, 2));
+  assertEqual(0, sntp.force_update()); // sets the clock
+  assertEqual(9, sntp.force_update());
+  assertEqual(0, sntp.get_number_of_survivors());
+  assertFalse(sntp.is_synchronized());
+}
+
+unittest(test_silent_server) {
+  ntp_server_simulator udp;
+  udp.server(IPAddress(192, 168, 178, 1)).silent = true;
+  udp.server(IPAddress(192, 168, 178, 2));
+  udp.server(IPAddress(192, 168, 178, 3));
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.add_server(IPAddress(192, 168, 178, 2));
+  sntp.add_server(IPAddress(192, 168, 178, 3));
+  assertEqual(0, sntp.force_update());
+  assertEqual(0, sntp.force_update());
+  assertEqual(2, sntp.get_number_of_survivors());
+  const int64_t error = udp.clock_error(sntp.get_local_clock());
+  assertLess(abs(error), (int64_t) (2 * UNITS_PER_MS));
+  // no server answers
+  udp.server(IPAddress(192, 168, 178, 2)).silent = true;
+  udp.server(IPAddress(192, 168, 178, 3)).silent = true;
+  assertEqual(6, sntp.force_update());
+}
+
+unittest_main()
@@ -0,0 +1,46 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <stddef.h>
+
+#include <precise_sntp_ntp_packet.h>
+
+unittest(test_layout) {
+  assertEqual(NTP_PACKET_SIZE, sizeof(struct ntp_packet_struct));
+  assertEqual(NTP_PACKET_SIZE, sizeof(union ntp_packet_union));
+  assertEqual(4, offsetof(struct ntp_packet_struct, rootdelay));
+  assertEqual(12, offsetof(struct ntp_packet_struct, refid));
+  assertEqual(16, offsetof(struct ntp_packet_struct, reftime));
+  assertEqual(24, offsetof(struct ntp_packet_struct, org));
+  assertEqual(32, offsetof(struct ntp_packet_struct, rec));
+  assertEqual(40, offsetof(struct ntp_packet_struct, xmt));
+}
+
+unittest(test_byte_order) {
+  union ntp_packet_union packet;
+  memset(packet.as_bytes, 0, NTP_PACKET_SIZE);
+  packet.as_bytes[4] = 0x01;
+  packet.as_bytes[5] = 0x02;
+  packet.as_bytes[6] = 0x03;
+  packet.as_bytes[7] = 0x04;
+  packet.as_bytes[40] = 0xE0;
+  packet.as_bytes[43] = 0x01;
+  packet.as_bytes[47] = 0x80;
+  ntp_short_format_ntoh(&(packet.as_ntp_packet.rootdelay));
+  assertEqual(0x0102, packet.as_ntp_packet.rootdelay.seconds);
+  assertEqual(0x0304, packet.as_ntp_packet.rootdelay.fraction);
+  ntp_timestamp_format_ntoh(&(packet.as_ntp_packet.xmt));
+  assertEqual(0xE0000001UL, packet.as_ntp_packet.xmt.seconds);
+  assertEqual(0x00000080UL, packet.as_ntp_packet.xmt.fraction);
+  ntp_timestamp_format_hton(&(packet.as_ntp_packet.xmt));
+  assertEqual(0xE0, packet.as_bytes[40]);
+  assertEqual(0x01, packet.as_bytes[43]);
+  assertEqual(0x80, packet.as_bytes[47]);
+}
+
+unittest_main()
@@ -0,0 +1,218 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Tests of the read-only view of received ntp packets
+  (src/precise_sntp_ntp_packet_view.h) and of the client against
+  hostile answers.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <string.h>
+
+#include <precise_sntp.h>
+#include <precise_sntp_ntp_packet_view.h>
+
+static void put32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t) (v >> 24);
+  p[1] = (uint8_t) (v >> 16);
+  p[2] = (uint8_t) (v >> 8);
+  p[3] = (uint8_t) v;
+}
+
+/*
+  a valid answer of a server (version 4, mode 4, stratum 2) to the request
+  with the transmit timestamp {0x01020304, 0x05060708}
+*/
+static void build_answer(uint8_t *p) {
+  memset(p, 0, NTP_PACKET_VIEW_SIZE);
+  p[0] = (4 << 3) | 4;
+  p[1] = 2;
+  p[2] = 6;
+  p[3] = (uint8_t) -20;
+  put32(p + NTP_PACKET_VIEW_ROOTDELAY, 0x00012345);
+  put32(p + NTP_PACKET_VIEW_ROOTDISP, 0x00006789);
+  memcpy(p + NTP_PACKET_VIEW_REFID, "GPS", 4);
+  put32(p + NTP_PACKET_VIEW_REFTIME, 0xEC000000);
+  put32(p + NTP_PACKET_VIEW_ORG, 0x01020304);
+  put32(p + NTP_PACKET_VIEW_ORG + 4, 0x05060708);
+  put32(p + NTP_PACKET_VIEW_REC, 0xEC000010);
+  put32(p + NTP_PACKET_VIEW_REC + 4, 0x80000000);
+  put32(p + NTP_PACKET_VIEW_XMT, 0xEC000010);
+  put32(p + NTP_PACKET_VIEW_XMT + 4, 0x80001000);
+}
+
+static const struct ntp_timestamp_format_struct request[2] = {
+  {0x11111111, 0x22222222}, {0x01020304, 0x05060708}};
+
+static uint8_t check(const uint8_t *p, size_t size = NTP_PACKET_VIEW_SIZE) {
+  uint8_t index;
+  return precise_sntp_ntp_packet_view(p).check(
+    size, NTP_PACKET_VIEW_MODE_SERVER, request, 2, &index);
+}
+
+unittest(test_fields) {
+  uint8_t p[NTP_PACKET_VIEW_SIZE];
+  build_answer(p);
+  const precise_sntp_ntp_packet_view view(p);
+  assertEqual(0, view.leap());
+  assertEqual(4, view.version());
+  assertEqual(4, view.mode());
+  assertEqual(2, view.stratum());
+  assertEqual(6, view.poll());
+  assertEqual(-20, view.precision());
+  assertEqual(0x00012345, view.rootdelay());
+  assertEqual(0x00006789, view.rootdisp());
+  assertEqual(0, memcmp(view.refid(), "GPS", 4));
+  assertEqual(0xEC000000, view.reftime().seconds);
+  assertEqual(0x01020304, view.org().seconds);
+  assertEqual(0x05060708, view.org().fraction);
+  assertEqual(0xEC000010, view.rec().seconds);
+  assertEqual(0x80000000, view.rec().fraction);
+  assertEqual(0x80001000, view.xmt().fraction);
+  uint8_t index;
+  assertEqual(0, view.check(NTP_PACKET_VIEW_SIZE, NTP_PACKET_VIEW_MODE_SERVER,
+			    request, 2, &index));
+  assertEqual(1, index);
+  // the buffer is not changed
+  uint8_t original[NTP_PACKET_VIEW_SIZE];
+  build_answer(original);
+  assertEqual(0, memcmp(original, p, NTP_PACKET_VIEW_SIZE));
+}
+
+unittest(test_bogus) {
+  uint8_t p[NTP_PACKET_VIEW_SIZE];
+  build_answer(p);
+  assertEqual(7, check(p, NTP_PACKET_VIEW_SIZE - 1));
+  p[0] = (4 << 3) | 3; // a request
+  assertEqual(7, check(p));
+  p[0] = (0 << 3) | 4; // version 0
+  assertEqual(7, check(p));
+  p[0] = (5 << 3) | 4; // version 5
+  assertEqual(7, check(p));
+  build_answer(p);
+  p[NTP_PACKET_VIEW_ORG + 7] ^= 1; // no matching origin timestamp
+  uint8_t index;
+  assertEqual(7, precise_sntp_ntp_packet_view(p).check(
+		NTP_PACKET_VIEW_SIZE, NTP_PACKET_VIEW_MODE_SERVER, request, 2,
+		&index));
+  assertEqual(2, index);
+  build_answer(p);
+  memset(p + NTP_PACKET_VIEW_REC, 0, 8);
+  assertEqual(7, check(p));
+  build_answer(p);
+  memset(p + NTP_PACKET_VIEW_XMT, 0, 8);
+  assertEqual(7, check(p));
+}
+
+unittest(test_not_synchronized) {
+  uint8_t p[NTP_PACKET_VIEW_SIZE];
+  build_answer(p);
+  p[1] = 0;
+  memcpy(p + NTP_PACKET_VIEW_REFID, "RATE", 4);
+  assertEqual(10, check(p));
+  memcpy(p + NTP_PACKET_VIEW_REFID, "DENY", 4);
+  assertEqual(11, check(p));
+  memcpy(p + NTP_PACKET_VIEW_REFID, "RSTR", 4);
+  assertEqual(11, check(p));
+  memcpy(p + NTP_PACKET_VIEW_REFID, "INIT", 4);
+  assertEqual(8, check(p));
+  build_answer(p);
+  p[1] = 16;
+  assertEqual(8, check(p));
+  build_answer(p);
+  p[0] |= 0xC0; // leap 3
+  assertEqual(8, check(p));
+}
+
+unittest(test_broadcast) {
+  uint8_t p[NTP_PACKET_VIEW_SIZE];
+  build_answer(p);
+  p[0] = (4 << 3) | 5;
+  memset(p + NTP_PACKET_VIEW_ORG, 0, 16); // no org and rec
+  const precise_sntp_ntp_packet_view view(p);
+  uint8_t index;
+  assertEqual(0, view.check(NTP_PACKET_VIEW_SIZE,
+			    NTP_PACKET_VIEW_MODE_BROADCAST, NULL, 0, &index));
+  assertEqual(7, view.check(NTP_PACKET_VIEW_SIZE, NTP_PACKET_VIEW_MODE_SERVER,
+			    request, 2, &index));
+  memset(p + NTP_PACKET_VIEW_XMT, 0, 8);
+  assertEqual(7, view.check(NTP_PACKET_VIEW_SIZE,
+			    NTP_PACKET_VIEW_MODE_BROADCAST, NULL, 0, &index));
+}
+
+/*
+  a server answering with the timestamps rec and xmt of the test
+*/
+class hostile_server : public UDP {
+ public:
+  uint32_t rec_seconds = 0;
+  uint32_t xmt_seconds = 0;
+  uint8_t begin(uint16_t) {
+    return 1;
+  }
+  int beginPacket(IPAddress, uint16_t) {
+    return 1;
+  }
+  int beginPacket(const char*, uint16_t) {
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t size) {
+    memcpy(_request, buffer, NTP_PACKET_VIEW_SIZE);
+    return size;
+  }
+  int endPacket() {
+    _answer = true;
+    return 1;
+  }
+  int parsePacket() {
+    return _answer ? NTP_PACKET_VIEW_SIZE : 0;
+  }
+  int read(unsigned char* buffer, size_t len) {
+    build_answer(buffer);
+    memcpy(buffer + NTP_PACKET_VIEW_ORG, _request + NTP_PACKET_VIEW_XMT, 8);
+    put32(buffer + NTP_PACKET_VIEW_REC, rec_seconds);
+    put32(buffer + NTP_PACKET_VIEW_XMT, xmt_seconds);
+    _answer = false;
+    return (int) len;
+  }
+  int read(char* buffer, size_t len) {
+    return read((unsigned char*) buffer, len);
+  }
+  IPAddress remoteIP() {
+    return IPAddress(192, 168, 178, 1);
+  }
+  uint16_t remotePort() {
+    return 123;
+  }
+
+ private:
+  uint8_t _request[NTP_PACKET_VIEW_SIZE] = {};
+  bool _answer = false;
+};
+
+unittest(test_hostile_timestamps) {
+  // offsets and delays close to +-2^63 (68 years) do not overflow
+  const uint32_t seconds[6] = {0x00000001, 0x40000000, 0x7FFFFFFF,
+			       0x80000000, 0xC0000000, 0xFFFFFFFF};
+  for (uint8_t i = 0; i < 36; i++) {
+    GODMODE()->reset();
+    GODMODE()->micros = 1000000;
+    hostile_server udp;
+    precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+    udp.rec_seconds = seconds[i / 6];
+    udp.xmt_seconds = seconds[i % 6];
+    for (uint8_t j = 0; j < 3; j++) {
+      sntp.force_update();
+      GODMODE()->micros += 1000000;
+    }
+    // a good server afterwards
+    udp.rec_seconds = 0xEC000010;
+    udp.xmt_seconds = 0xEC000010;
+    assertEqual(0, sntp.force_update());
+  }
+}
+
+unittest_main()
@@ -0,0 +1,121 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Benchmark of the decoding of ntp answers: the read-only view
+  (src/precise_sntp_ntp_packet_view.h) compared to copying the packet in
+  a struct (src/precise_sntp_ntp_packet.h) and converting the byte order
+  of the fields in place.
+
+  The answers per second (cpu time of the host) are printed for
+  BENCHMARK_PACKETS decoded answers. The asserts only check, that both
+  ways give the same result.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <precise_sntp.h>
+#include <precise_sntp_ntp_packet.h>
+#include <precise_sntp_ntp_packet_view.h>
+#include <precise_sntp_xorshift32.h>
+
+#define BENCHMARK_PACKETS 1000000UL
+#define BENCHMARK_BUFFERS 64
+
+static uint8_t packets[BENCHMARK_BUFFERS][NTP_PACKET_SIZE];
+static const struct ntp_timestamp_format_struct request = {0x01020304,
+							    0x05060708};
+
+static void print_rate(const char *name, clock_t start) {
+  const double seconds = ((double) (clock() - start)) / CLOCKS_PER_SEC;
+  printf("%-24s %8.1f million answers per second\n", name,
+	 BENCHMARK_PACKETS / seconds / 1e6);
+}
+
+/*
+  answers with random timestamps
+*/
+static void build_packets() {
+  uint32_t state = 0x12345678;
+  for (uint8_t i = 0; i < BENCHMARK_BUFFERS; i++) {
+    uint8_t *p = packets[i];
+    for (uint8_t j = 0; j < NTP_PACKET_SIZE; j++) {
+      p[j] = (uint8_t) precise_sntp_xorshift32(&state);
+    }
+    p[0] = (4 << 3) | 4;
+    p[1] = 2;
+    p[4] = p[5] = p[8] = p[9] = 0; // small root delay and dispersion
+    p[24] = 0x01;
+    p[25] = 0x02;
+    p[26] = 0x03;
+    p[27] = 0x04;
+    p[28] = 0x05;
+    p[29] = 0x06;
+    p[30] = 0x07;
+    p[31] = 0x08;
+  }
+}
+
+/*
+  decodes like the client did before the view: copy, convert the byte
+  order in place and check
+*/
+static uint64_t decode_struct(const uint8_t *data) {
+  union ntp_packet_union packet;
+  memcpy(packet.as_bytes, data, NTP_PACKET_SIZE);
+  ntp_short_format_ntoh(&packet.as_ntp_packet.rootdelay);
+  ntp_short_format_ntoh(&packet.as_ntp_packet.rootdisp);
+  ntp_timestamp_format_ntoh(&packet.as_ntp_packet.org);
+  ntp_timestamp_format_ntoh(&packet.as_ntp_packet.rec);
+  ntp_timestamp_format_ntoh(&packet.as_ntp_packet.xmt);
+  if ((packet.as_ntp_packet.org.seconds != request.seconds) ||
+      (packet.as_ntp_packet.org.fraction != request.fraction) ||
+      (packet.as_ntp_packet.stratum < 1) ||
+      (packet.as_ntp_packet.stratum > 15) ||
+      ((packet.as_ntp_packet.leap_version_mode >> 6) == 3)) {
+    return 0;
+  }
+  return (((uint64_t) packet.as_ntp_packet.rec.seconds) << 32) +
+    packet.as_ntp_packet.xmt.fraction + packet.as_ntp_packet.rootdelay.seconds +
+    packet.as_ntp_packet.rootdisp.fraction + packet.as_ntp_packet.poll;
+}
+
+static uint64_t decode_view(const uint8_t *data) {
+  const precise_sntp_ntp_packet_view packet(data);
+  uint8_t index;
+  if (packet.check(NTP_PACKET_SIZE, NTP_PACKET_VIEW_MODE_SERVER, &request, 1,
+		   &index) != 0) {
+    return 0;
+  }
+  return (((uint64_t) packet.rec().seconds) << 32) + packet.xmt().fraction +
+    (packet.rootdelay() >> 16) + (packet.rootdisp() & 0xFFFF) +
+    packet.poll();
+}
+
+unittest(benchmark_decode) {
+  build_packets();
+  for (uint8_t i = 0; i < BENCHMARK_BUFFERS; i++) {
+    assertEqual(decode_struct(packets[i]), decode_view(packets[i]));
+    assertNotEqual(0, decode_view(packets[i]));
+  }
+  volatile uint64_t sum_struct = 0;
+  clock_t start = clock();
+  for (unsigned long i = 0; i < BENCHMARK_PACKETS; i++) {
+    sum_struct += decode_struct(packets[i % BENCHMARK_BUFFERS]);
+  }
+  print_rate("copy and ntoh in place", start);
+  volatile uint64_t sum_view = 0;
+  start = clock();
+  for (unsigned long i = 0; i < BENCHMARK_PACKETS; i++) {
+    sum_view += decode_view(packets[i % BENCHMARK_BUFFERS]);
+  }
+  print_rate("view", start);
+  assertEqual(sum_struct, sum_view);
+}
+
+unittest_main()
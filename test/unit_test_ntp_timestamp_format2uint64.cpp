@@ -0,0 +1,24 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp.h>
+#include <precise_sntp_ntp_timestamp_format2uint64.h>
+
+unittest(test_ntp_timestamp_format2uint64) {
+  struct ntp_timestamp_format_struct value;
+  value.seconds = 0x01234567UL;
+  value.fraction = 0x89ABCDEFUL;
+  uint64_t result = 0x123456789ABCDEF;
+  assertEqual(result, ntp_timestamp_format2uint64(value));
+  value.seconds = 0xFECDBA98UL;
+  value.fraction = 0x76543210UL;
+  result = 0xFECDBA9876543210ULL;
+  assertEqual(result, ntp_timestamp_format2uint64(value));
+}
+
+unittest_main()
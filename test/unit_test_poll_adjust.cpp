@@ -0,0 +1,129 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Tests of the poll-adjust of update_adapt_poll_period() (see
+  get_poll_exponent()) against the simulated ntp server in
+  extras/ntp_server_simulator.h.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp.h>
+#include "../extras/ntp_server_simulator.h"
+
+unittest_setup() {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+}
+
+/*
+  calls update_adapt_poll_period() every second for the given time,
+  returns the smallest poll exponent seen
+*/
+static uint8_t run(precise_sntp &sntp, ntp_server_simulator &udp,
+		   uint32_t seconds) {
+  uint8_t smallest = sntp.get_poll_exponent();
+  for (uint32_t i = 0; i < seconds; i++) {
+    sntp.update_adapt_poll_period();
+    udp.advance(1000000);
+    if (sntp.get_poll_exponent() < smallest) {
+      smallest = sntp.get_poll_exponent();
+    }
+  }
+  return smallest;
+}
+
+unittest(test_rises_on_clean_link) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  run(sntp, udp, 60);
+  assertEqual(6, sntp.get_poll_exponent());
+  run(sntp, udp, 2 * 3600);
+  assertEqual(10, sntp.get_poll_exponent());
+  // and stays there
+  assertEqual(10, run(sntp, udp, 6 * 3600));
+}
+
+unittest(test_jitter_does_not_lower) {
+  ntp_server_simulator udp;
+  udp.parameter.latency_up_us = 8000;
+  udp.parameter.latency_down_us = 15000;
+  udp.parameter.jitter_us = 5000;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  run(sntp, udp, 3 * 3600);
+  assertEqual(10, sntp.get_poll_exponent());
+  // jitter is averaged best by long poll periods
+  assertEqual(10, run(sntp, udp, 12 * 3600));
+}
+
+unittest(test_falls_on_wandering_clock) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  run(sntp, udp, 2 * 3600);
+  assertEqual(10, sntp.get_poll_exponent());
+  // the frequency of the oscillator changes by 20 ppm per hour (e. g. by
+  // the temperature), the time of the server stays continuous
+  uint8_t smallest = 10;
+  for (uint16_t i = 0; i < 12 * 360; i++) {
+    const uint64_t before = udp.true_time(micros());
+    udp.parameter.drift_ppm += 20.0 / 360.0;
+    udp.parameter.offset_us +=
+      (int32_t) (((int64_t) (before - udp.true_time(micros()))) / 4295);
+    const uint8_t s = run(sntp, udp, 10);
+    if (s < smallest) {
+      smallest = s;
+    }
+  }
+  assertLess(smallest, 10);
+  assertMoreOrEqual(smallest, 6);
+  // and rises again, when the frequency is stable
+  run(sntp, udp, 12 * 3600);
+  assertEqual(10, sntp.get_poll_exponent());
+}
+
+unittest(test_single_loss_does_not_change) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  // wait until the poll exponent rose to 8
+  uint32_t seconds = 0;
+  while ((sntp.get_poll_exponent() != 8) && (seconds < 4 * 3600)) {
+    run(sntp, udp, 1);
+    seconds++;
+  }
+  assertEqual(8, sntp.get_poll_exponent());
+  // the next request is lost
+  udp.parameter.silent = true;
+  const uint32_t sent = udp.packets_sent;
+  while (udp.packets_sent == sent) {
+    run(sntp, udp, 1);
+  }
+  run(sntp, udp, 2);
+  assertEqual(8, sntp.get_poll_exponent());
+  // the retry succeeds
+  udp.parameter.silent = false;
+  assertEqual(8, run(sntp, udp, 60));
+  assertEqual(8, sntp.get_poll_exponent());
+}
+
+unittest(test_stays_in_shrunk_range) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  run(sntp, udp, 2 * 3600);
+  assertEqual(10, sntp.get_poll_exponent());
+  sntp.set_poll_exponent_range(6, 8);
+  // the next poll is planned with the old poll exponent
+  run(sntp, udp, 1030);
+  assertEqual(8, sntp.get_poll_exponent());
+  for (uint8_t i = 0; i < 24; i++) {
+    assertMoreOrEqual(run(sntp, udp, 600), 6);
+    assertLessOrEqual(sntp.get_poll_exponent(), 8);
+  }
+  // a higher minimum raises the poll exponent
+  sntp.set_poll_exponent_range(9, 10);
+  run(sntp, udp, 300);
+  assertMoreOrEqual(run(sntp, udp, 2 * 3600), 9);
+}
+
+unittest_main()
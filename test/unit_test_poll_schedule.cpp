@@ -0,0 +1,154 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Tests of the scheduling of the polls: random start delay, jitter of the
+  poll period and exponential backoff after unsuccessful polls.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <limits.h>
+
+#include <precise_sntp.h>
+#include "../extras/ntp_server_simulator.h"
+
+unittest_setup() {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+}
+
+/*
+  calls update_async() every 100 ms until the first request is sent,
+  returns the milliseconds waited (including the 100 ms after the request)
+*/
+static unsigned long first_request(ntp_server_simulator &udp,
+				   precise_sntp &sntp) {
+  const unsigned long start = millis();
+  while (udp.packets_sent == 0) {
+    sntp.update_async();
+    udp.advance(100000);
+  }
+  return millis() - start;
+}
+
+unittest(test_start_delay) {
+  ntp_server_simulator udp1;
+  precise_sntp sntp1(udp1, IPAddress(192, 168, 178, 1));
+  sntp1.set_random_seed(1);
+  sntp1.set_start_delay(60000);
+  const unsigned long delay1 = first_request(udp1, sntp1);
+  assertLessOrEqual(delay1, 60200UL);
+  GODMODE()->micros = 1000000;
+  ntp_server_simulator udp2;
+  precise_sntp sntp2(udp2, IPAddress(192, 168, 178, 1));
+  sntp2.set_random_seed(2);
+  sntp2.set_start_delay(60000);
+  const unsigned long delay2 = first_request(udp2, sntp2);
+  assertLessOrEqual(delay2, 60200UL);
+  assertNotEqual(delay1, delay2);
+  // without start delay the first call polls
+  GODMODE()->micros = 1000000;
+  ntp_server_simulator udp3;
+  precise_sntp sntp3(udp3, IPAddress(192, 168, 178, 1));
+  const unsigned long delay3 = first_request(udp3, sntp3);
+  assertEqual(100UL, delay3);
+}
+
+unittest(test_start_delay_limit) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_start_delay(ULONG_MAX);
+  const unsigned long delay = first_request(udp, sntp);
+  assertLessOrEqual(delay, PRECISE_SNTP_MAX_START_DELAY + 200UL);
+}
+
+unittest(test_backoff) {
+  ntp_server_simulator udp;
+  udp.parameter.silent = true;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_poll_exponent_range(6, 10);
+  unsigned long last = 0;
+  unsigned long last_interval = 0;
+  uint32_t requests = 0;
+  for (uint32_t i = 0; i < 3000; i++) { // 300 s
+    sntp.update_async();
+    if (udp.packets_sent > requests) {
+      requests = udp.packets_sent;
+      const unsigned long now = millis();
+      if (requests > 2) {
+	// each interval is the timeout (1 s) and a random delay
+	// from 0.5 to 1 times 1 s, 2 s, 4 s, ... 64 s
+	const unsigned long interval = now - last;
+	assertMoreOrEqual(interval + 100, last_interval);
+	assertLessOrEqual(interval, 1000UL + 64000UL + 200UL);
+	last_interval = (interval < 33000UL) ? interval : 33000UL;
+      }
+      last = now;
+    }
+    udp.advance(100000);
+  }
+  // without backoff it would be about 270 requests
+  assertMore(requests, 8);
+  assertLess(requests, 16);
+  // a successful poll resets the backoff
+  udp.parameter.silent = false;
+  while (sntp.update_async() != 0) {
+    udp.advance(100000);
+  }
+  udp.parameter.silent = true;
+  requests = udp.packets_sent;
+  while (sntp.update_async() != 6) {
+    udp.advance(100000);
+  }
+  udp.advance(100000);
+  for (uint8_t i = 0; i < 10; i++) {
+    sntp.update_async();
+    udp.advance(100000);
+  }
+  // next request after 0.5 to 1 s
+  assertEqual(requests + 2, udp.packets_sent);
+}
+
+unittest(test_backoff_kod) {
+  ntp_server_simulator udp;
+  udp.parameter.stratum = 0;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_poll_exponent_range(6, 10);
+  assertEqual(8, sntp.update());
+  // at least half of the minimal poll period
+  for (uint16_t i = 0; i < 310; i++) {
+    assertEqual(1, sntp.update_async());
+    udp.advance(100000);
+  }
+  assertEqual(1, udp.packets_sent);
+}
+
+unittest(test_poll_jitter) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_poll_exponent_range(6, 6);
+  sntp.set_poll_jitter(20);
+  unsigned long last = 0;
+  unsigned long minimum = 64000;
+  unsigned long maximum = 0;
+  for (uint32_t i = 0; i < 20000; i++) {
+    const uint8_t ret = sntp.update_async();
+    if ((ret == 0) && (udp.packets_sent > 2)) {
+      const unsigned long interval = millis() - last;
+      minimum = (interval < minimum) ? interval : minimum;
+      maximum = (interval > maximum) ? interval : maximum;
+    }
+    if (ret == 0) {
+      last = millis();
+    }
+    udp.advance(100000);
+  }
+  // the period of 64 s is shortened by up to 20 %
+  assertMoreOrEqual(minimum, 51200UL - 200UL);
+  assertLessOrEqual(maximum, 64000UL + 200UL);
+  assertMore(maximum - minimum, 5000UL);
+}
+
+unittest_main()
@@ -0,0 +1,134 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Loopback tests of the POSIX UDP backend (extras/posix/posix_udp.h)
+  against the stand-in ntp server in extras/posix/ntp_responder.h using
+  real sockets. The mocked clock (GODMODE()->micros) follows
+  CLOCK_MONOTONIC, so millis() and micros() run in real time.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <time.h>
+#include <unistd.h>
+
+#include "../extras/posix/posix_udp.h"
+#include "../extras/posix/ntp_responder.h"
+#include <precise_sntp.h>
+
+#define RESPONDER_PORT 12300
+#define UNITS_PER_MS 4294967.296
+
+#ifdef PRECISE_SNTP_USE_MICROS
+#define MAX_ERROR_MS 1.0
+#else
+#define MAX_ERROR_MS 3.0
+#endif
+
+/*
+  sets the mocked clock to CLOCK_MONOTONIC
+*/
+static void follow_monotonic() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  GODMODE()->micros = (unsigned long)
+    (((uint64_t) ts.tv_sec) * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+/*
+  polls the responder, which answers 1 ms after the request (processing
+  time of the server, the mocked clock is not running inside of
+  service()), the answer waits hold_us microseconds in the socket before
+  service() looks for it; returns the result of the poll
+*/
+static uint8_t poll(precise_sntp &sntp, posix_ntp_responder &responder,
+		    unsigned long hold_us) {
+  follow_monotonic();
+  if (!sntp.begin_poll()) {
+    return 1;
+  }
+  uint8_t ret = sntp.service(); // sends the request
+  usleep(1000);
+  while (ret == PRECISE_SNTP_POLL_PENDING) {
+    if (responder.service() > 0) {
+      usleep(hold_us);
+    }
+    follow_monotonic();
+    ret = sntp.service();
+  }
+  return ret;
+}
+
+/*
+  error of the local clock compared to the clock of the responder in ms
+*/
+static double error_ms(precise_sntp &sntp, posix_ntp_responder &responder) {
+  follow_monotonic();
+  const struct ntp_timestamp_format_struct local = sntp.get_local_clock();
+  const uint64_t served = responder.now();
+  return ((double) (int64_t) (((((uint64_t) local.seconds) << 32) |
+			       local.fraction) - served)) / UNITS_PER_MS;
+}
+
+unittest(test_loopback) {
+  posix_ntp_responder responder;
+  assertTrue(responder.begin(RESPONDER_PORT));
+  responder.set_offset(250000000LL); // the served clock is 0.25 s ahead
+  posix_udp udp;
+  udp.set_destination_port(RESPONDER_PORT);
+  precise_sntp sntp(udp, IPAddress(127, 0, 0, 1));
+  sntp.set_receive_timestamp_hook(posix_udp::receive_timestamp_hook);
+  for (uint8_t i = 0; i < 8; i++) {
+    const uint8_t ret = poll(sntp, responder, 0);
+    assertEqual(0, ret);
+  }
+  assertEqual(8, responder.answers);
+  assertEqual(1, sntp.get_stratum());
+  assertTrue(udp.remoteIP() == IPAddress(127, 0, 0, 1));
+  assertEqual(RESPONDER_PORT, udp.remotePort());
+  assertLess(fabs(error_ms(sntp, responder)), MAX_ERROR_MS);
+  assertLess(sntp.get_delay() / UNITS_PER_MS, MAX_ERROR_MS);
+}
+
+unittest(test_kernel_timestamp) {
+  posix_ntp_responder responder;
+  assertTrue(responder.begin(RESPONDER_PORT));
+  {
+    // T4 is taken by parsePacket(): the answer waited 20 ms
+    posix_udp udp;
+    udp.set_destination_port(RESPONDER_PORT);
+    precise_sntp sntp(udp, IPAddress(127, 0, 0, 1));
+    assertEqual(0, poll(sntp, responder, 0)); // sets the clock
+    const uint8_t ret = poll(sntp, responder, 20000);
+    assertEqual(0, ret);
+    assertMore(sntp.get_delay() / UNITS_PER_MS, 19.0);
+  }
+  {
+    // T4 is the time the kernel received the answer
+    posix_udp udp;
+    udp.set_destination_port(RESPONDER_PORT);
+    precise_sntp sntp(udp, IPAddress(127, 0, 0, 1));
+    sntp.set_receive_timestamp_hook(posix_udp::receive_timestamp_hook);
+    assertEqual(0, poll(sntp, responder, 0)); // sets the clock
+    const uint8_t ret = poll(sntp, responder, 20000);
+    assertEqual(0, ret);
+    unsigned long ticks;
+    assertTrue(udp.get_receive_ticks(&ticks));
+    assertLess(sntp.get_delay() / UNITS_PER_MS, MAX_ERROR_MS);
+    assertLess(fabs(error_ms(sntp, responder)), MAX_ERROR_MS);
+  }
+}
+
+unittest(test_no_responder) {
+  posix_udp udp;
+  udp.set_destination_port(RESPONDER_PORT + 1);
+  precise_sntp sntp(udp, IPAddress(127, 0, 0, 1));
+  posix_ntp_responder responder; // not listening
+  const uint8_t ret = poll(sntp, responder, 0);
+  assertEqual(6, ret);
+  assertEqual(0, udp.parsePacket());
+}
+
+unittest_main()
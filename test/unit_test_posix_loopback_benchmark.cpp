@@ -0,0 +1,110 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  End-to-end latency benchmark of the POSIX UDP backend
+  (extras/posix/posix_udp.h) against the stand-in ntp server in
+  extras/posix/ntp_responder.h over the loopback interface.
+
+  For each poll the wall time from begin_poll() until the result (in us,
+  CLOCK_MONOTONIC) and the error of the local clock to the served clock
+  afterwards (in us) are measured. The answer waits in the socket (e. g.
+  a busy main loop) before service() looks for it; with the receive
+  timestamps of the kernel this waiting does not disturb the clock. The
+  asserts only check, that all polls succeed.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../extras/posix/posix_udp.h"
+#include "../extras/posix/ntp_responder.h"
+#include <precise_sntp.h>
+
+#define RESPONDER_PORT 12301
+#define BENCHMARK_POLLS 500
+#define UNITS_PER_US 4294.967296
+
+static uint64_t monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+  sets the mocked clock to CLOCK_MONOTONIC
+*/
+static void follow_monotonic() {
+  GODMODE()->micros = (unsigned long) (monotonic_ns() / 1000);
+}
+
+static uint8_t poll(precise_sntp &sntp, posix_ntp_responder &responder,
+		    unsigned long hold_us) {
+  follow_monotonic();
+  sntp.begin_poll();
+  uint8_t ret = sntp.service(); // sends the request
+  while (ret == PRECISE_SNTP_POLL_PENDING) {
+    if ((responder.service() > 0) && (hold_us > 0)) {
+      usleep(hold_us);
+    }
+    follow_monotonic();
+    ret = sntp.service();
+  }
+  return ret;
+}
+
+static int compare_double(const void *a, const void *b) {
+  const double x = *((const double*) a);
+  const double y = *((const double*) b);
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+static void run_benchmark(const char *name, bool kernel_timestamps,
+			  unsigned long hold_us) {
+  posix_ntp_responder responder;
+  assertTrue(responder.begin(RESPONDER_PORT));
+  posix_udp udp;
+  udp.set_destination_port(RESPONDER_PORT);
+  precise_sntp sntp(udp, IPAddress(127, 0, 0, 1));
+  if (kernel_timestamps) {
+    sntp.set_receive_timestamp_hook(posix_udp::receive_timestamp_hook);
+  }
+  static double latency[BENCHMARK_POLLS];
+  static double error[BENCHMARK_POLLS];
+  uint16_t failed = 0;
+  for (uint16_t i = 0; i < 8; i++) {
+    failed += (poll(sntp, responder, hold_us) != 0);
+  }
+  for (uint16_t i = 0; i < BENCHMARK_POLLS; i++) {
+    const uint64_t start = monotonic_ns();
+    failed += (poll(sntp, responder, hold_us) != 0);
+    latency[i] = (monotonic_ns() - start) / 1000.0;
+    follow_monotonic();
+    const struct ntp_timestamp_format_struct local = sntp.get_local_clock();
+    error[i] = fabs(((double) (int64_t)
+		     (((((uint64_t) local.seconds) << 32) | local.fraction) -
+		      responder.now())) / UNITS_PER_US);
+  }
+  qsort(latency, BENCHMARK_POLLS, sizeof(double), compare_double);
+  qsort(error, BENCHMARK_POLLS, sizeof(double), compare_double);
+  printf("%-22s %8.1f %8.1f %8.1f %10.1f %10.1f\n", name, latency[0],
+	 latency[BENCHMARK_POLLS / 2], latency[BENCHMARK_POLLS * 99 / 100],
+	 error[BENCHMARK_POLLS / 2], error[BENCHMARK_POLLS - 1]);
+  assertEqual(0, failed);
+}
+
+unittest(benchmark_latency) {
+  printf("%-22s %8s %8s %8s %10s %10s\n", "receive time", "min/us",
+	 "median", "p99", "error/us", "max error");
+  run_benchmark("parsePacket()", false, 0);
+  run_benchmark("kernel", true, 0);
+  run_benchmark("parsePacket(), 500 us", false, 500);
+  run_benchmark("kernel, 500 us", true, 500);
+}
+
+unittest_main()
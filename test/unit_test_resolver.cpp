@@ -0,0 +1,120 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Tests of the cached name resolution (set_resolver()) against the
+  simulated ntp servers in extras/ntp_server_simulator.h.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp.h>
+#include "../extras/ntp_server_simulator.h"
+
+static uint16_t resolver_calls = 0;
+static bool resolver_down = false;
+
+// a pool name rotating over 3 addresses
+static int resolver(const char* name, IPAddress &ip) {
+  if (resolver_down || (strcmp(name, "pool.example.org") != 0)) {
+    return 0;
+  }
+  ip = IPAddress(192, 168, 178, 1 + (resolver_calls % 3));
+  resolver_calls++;
+  return 1;
+}
+
+// a pool name answering each address twice
+static int slow_rotating_resolver(const char* name, IPAddress &ip) {
+  (void) name;
+  ip = IPAddress(192, 168, 178, 1 + ((resolver_calls / 2) % 3));
+  resolver_calls++;
+  return 1;
+}
+
+unittest_setup() {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+  resolver_calls = 0;
+  resolver_down = false;
+}
+
+unittest(test_without_resolver) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, "pool.example.org");
+  assertEqual(0, sntp.force_update());
+  assertEqual(0, sntp.force_update());
+  assertEqual(2, udp.begin_packet_by_name);
+}
+
+unittest(test_cached_address) {
+  ntp_server_simulator udp;
+  udp.server(IPAddress(192, 168, 178, 1));
+  udp.server(IPAddress(192, 168, 178, 2));
+  precise_sntp sntp(udp, "pool.example.org");
+  sntp.set_resolver(resolver);
+  sntp.set_resolve_lifetime(600);
+  for (uint8_t i = 0; i < 5; i++) {
+    assertEqual(0, sntp.force_update());
+    udp.advance(60000000);
+  }
+  assertEqual(1, resolver_calls);
+  assertEqual(0, udp.begin_packet_by_name);
+  assertEqual(5, udp.server(IPAddress(192, 168, 178, 1)).requests);
+  // the lifetime is over
+  udp.advance(600000000);
+  assertEqual(0, sntp.force_update());
+  assertEqual(2, resolver_calls);
+  assertEqual(1, udp.server(IPAddress(192, 168, 178, 2)).requests);
+}
+
+unittest(test_resolver_down) {
+  ntp_server_simulator udp;
+  udp.server(IPAddress(192, 168, 178, 1));
+  precise_sntp sntp(udp, "pool.example.org");
+  sntp.set_resolver(resolver);
+  sntp.set_resolve_lifetime(60);
+  assertEqual(0, sntp.force_update());
+  resolver_down = true;
+  udp.advance(120000000);
+  // the cached address is used further
+  assertEqual(0, sntp.force_update());
+  assertEqual(2, udp.server(IPAddress(192, 168, 178, 1)).requests);
+  assertEqual(0, udp.begin_packet_by_name);
+}
+
+unittest(test_resolve_again_after_failures) {
+  ntp_server_simulator udp;
+  udp.server(IPAddress(192, 168, 178, 1)).silent = true;
+  udp.server(IPAddress(192, 168, 178, 2));
+  precise_sntp sntp(udp, "pool.example.org");
+  sntp.set_resolver(resolver);
+  for (uint8_t i = 0; i < 3; i++) {
+    assertEqual(6, sntp.force_update());
+  }
+  assertEqual(1, resolver_calls);
+  assertEqual(0, sntp.force_update());
+  assertEqual(2, resolver_calls);
+  assertEqual(3, udp.server(IPAddress(192, 168, 178, 1)).requests);
+  assertEqual(1, udp.server(IPAddress(192, 168, 178, 2)).requests);
+}
+
+unittest(test_rotate_pool_members) {
+  ntp_server_simulator udp;
+  for (uint8_t i = 1; i <= 3; i++) {
+    udp.server(IPAddress(192, 168, 178, i));
+  }
+  precise_sntp sntp(udp, "pool.example.org");
+  sntp.add_server("pool.example.org");
+  sntp.add_server("pool.example.org");
+  sntp.set_resolver(slow_rotating_resolver);
+  assertEqual(0, sntp.force_update());
+  // the second and third server asked again to get a new address
+  assertEqual(5, resolver_calls);
+  for (uint8_t i = 1; i <= 3; i++) {
+    assertEqual(1, udp.server(IPAddress(192, 168, 178, i)).requests);
+  }
+}
+
+unittest_main()
@@ -0,0 +1,135 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Tests of the server (src/precise_sntp_server.h) using the load generator
+  in extras/ntp_client_load_generator.h. The client of the server gets the
+  time from the simulated ntp server in extras/ntp_server_simulator.h.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp.h>
+#include <precise_sntp_server.h>
+#include "../extras/ntp_server_simulator.h"
+#include "../extras/ntp_client_load_generator.h"
+
+#define UNITS_PER_MS 4294967.296
+
+unittest_setup() {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+}
+
+unittest(test_not_synchronized) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  ntp_client_load_generator clients;
+  precise_sntp_server server(clients, sntp);
+  assertTrue(server.begin());
+  assertEqual(0, server.service());
+  clients.request(IPAddress(192, 168, 1, 10));
+  assertEqual(1, server.service());
+  assertEqual(0, clients.bad_answers);
+  assertEqual(3, clients.last_answer[0] >> 6); // alarm
+  assertEqual(16, clients.last_answer[1]);
+}
+
+unittest(test_single_answer) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  // the clock is only set by the transmit timestamp of one answer
+  assertEqual(0, sntp.update());
+  ntp_client_load_generator clients;
+  precise_sntp_server server(clients, sntp);
+  clients.request(IPAddress(192, 168, 1, 10));
+  assertEqual(1, server.service());
+  assertEqual(0, clients.bad_answers);
+  assertEqual(3, clients.last_answer[0] >> 6); // alarm
+  assertEqual(16, clients.last_answer[1]);
+  // root dispersion: the error bound of 16 s
+  assertMoreOrEqual(clients.answer32(8), 0x000F0000UL);
+}
+
+unittest(test_answer) {
+  ntp_server_simulator udp;
+  udp.parameter.stratum = 2;
+  udp.parameter.rootdelay = 65536 / 100; // 10 ms
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  // fill the clock filter, the dispersion of empty stages is too large
+  for (uint8_t i = 0; i < PRECISE_SNTP_FILTER_STAGES; i++) {
+    const uint8_t ret = sntp.force_update();
+    assertEqual(0, ret);
+  }
+  assertLess(sntp.get_sync_distance(), ((uint64_t) 3) << 31);
+  ntp_client_load_generator clients;
+  precise_sntp_server server(clients, sntp);
+  clients.request(IPAddress(192, 168, 1, 10), 3);
+  assertEqual(1, server.service());
+  assertEqual(0, clients.bad_answers);
+  assertTrue(clients.last_answer_ip == IPAddress(192, 168, 1, 10));
+  assertEqual(0, clients.last_answer[0] >> 6);
+  assertEqual(3, (clients.last_answer[0] >> 3) & 0x07); // version
+  assertEqual(3, clients.last_answer[1]); // stratum
+  assertEqual(6, clients.last_answer[2]); // poll of the request
+  assertEqual((uint8_t) sntp.get_precision(), clients.last_answer[3]);
+  // root delay: 10 ms of the server and the delay to it (about 1 ms)
+  const double rootdelay = clients.answer32(4) / 65.536;
+  assertMore(rootdelay, 10.5);
+  assertLess(rootdelay, 12.0);
+  assertEqual(0xC0A8B201UL, clients.answer32(12)); // reference id
+  // receive and transmit timestamps are the true time
+  struct ntp_timestamp_format_struct xmt;
+  xmt.seconds = clients.answer32(40);
+  xmt.fraction = clients.answer32(44);
+  const double error = ((double) udp.clock_error(xmt)) / UNITS_PER_MS;
+  assertLess(fabs(error), 2.0);
+  assertMoreOrEqual(clients.answer32(40), clients.answer32(32));
+  assertLessOrEqual(clients.answer32(16), clients.answer32(32)); // reftime
+}
+
+unittest(test_burst) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(0, sntp.update());
+  ntp_client_load_generator clients;
+  precise_sntp_server server(clients, sntp);
+  for (uint8_t i = 0; i < PRECISE_SNTP_SERVER_BURST + 2; i++) {
+    clients.request(IPAddress(192, 168, 1, 10 + i));
+  }
+  // bogus packets: server mode and version 0
+  clients.request(IPAddress(192, 168, 1, 100), 4, 4);
+  clients.request(IPAddress(192, 168, 1, 101), 0, 3);
+  assertEqual(PRECISE_SNTP_SERVER_BURST, server.service());
+  assertEqual(2, server.service());
+  assertEqual(0, server.service());
+  assertEqual(0, clients.bad_answers);
+  const struct precise_sntp_server_statistics stat = server.get_statistics();
+  assertEqual(PRECISE_SNTP_SERVER_BURST + 4, stat.requests);
+  assertEqual(PRECISE_SNTP_SERVER_BURST + 2, stat.answers);
+  assertEqual(2, stat.bogus);
+}
+
+unittest(test_rate_limit) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(0, sntp.update());
+  ntp_client_load_generator clients;
+  precise_sntp_server server(clients, sntp);
+  server.set_rate_limit(2000);
+  clients.request(IPAddress(192, 168, 1, 10));
+  clients.request(IPAddress(192, 168, 1, 11));
+  clients.request(IPAddress(192, 168, 1, 10));
+  assertEqual(3, server.service());
+  assertEqual(0, clients.last_answer[1]); // kiss-o'-death
+  assertEqual(0, memcmp(clients.last_answer + 12, "RATE", 4));
+  udp.advance(2100000);
+  clients.request(IPAddress(192, 168, 1, 10));
+  assertEqual(1, server.service());
+  assertNotEqual(0, clients.last_answer[1]);
+  assertEqual(0, clients.bad_answers);
+  assertEqual(1, server.get_statistics().rate_limited);
+}
+
+unittest_main()
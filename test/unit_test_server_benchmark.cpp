@@ -0,0 +1,60 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Throughput benchmark of the server (src/precise_sntp_server.h) against
+  the load generator in extras/ntp_client_load_generator.h.
+
+  The load generator queues requests of many clients and service() answers
+  them. The requests per second (cpu time of the host) are printed for
+  the server without and with rate limit. The asserts only check, that
+  all requests are answered correctly.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <stdio.h>
+#include <time.h>
+
+#include <precise_sntp.h>
+#include <precise_sntp_server.h>
+#include "../extras/ntp_server_simulator.h"
+#include "../extras/ntp_client_load_generator.h"
+
+#define BENCHMARK_REQUESTS 200000UL
+
+static void run_benchmark(const char *name, uint16_t min_interval) {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(0, sntp.update());
+  ntp_client_load_generator clients;
+  precise_sntp_server server(clients, sntp);
+  server.set_rate_limit(min_interval);
+  uint32_t answers = 0;
+  const clock_t start = clock();
+  for (uint32_t i = 0; i < BENCHMARK_REQUESTS; i += 32) {
+    for (uint8_t j = 0; j < 32; j++) {
+      clients.request(IPAddress(10, 0, (uint8_t) (j >> 8), (uint8_t) j));
+    }
+    while (clients.answers < clients.requests) {
+      answers += server.service();
+    }
+    udp.advance(1000);
+  }
+  const double seconds = ((double) (clock() - start)) / CLOCKS_PER_SEC;
+  printf("%-12s %10u %12.0f\n", name, (unsigned int) answers,
+	 (seconds > 0) ? answers / seconds : 0.0);
+  assertEqual(clients.requests, answers);
+  assertEqual(0, clients.bad_answers);
+}
+
+unittest(benchmark_throughput) {
+  printf("%-12s %10s %12s\n", "server", "answers", "requests/s");
+  run_benchmark("plain", 0);
+  run_benchmark("rate limit", 2000);
+}
+
+unittest_main()
@@ -0,0 +1,211 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Tests of the poll engine, clock filter and frequency discipline against
+  the simulated ntp server in extras/ntp_server_simulator.h.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp.h>
+#include "../extras/ntp_server_simulator.h"
+
+#define UNITS_PER_MS 4294967.296
+
+unittest_setup() {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+}
+
+unittest(test_service_does_not_block) {
+  ntp_server_simulator udp;
+  udp.parameter.latency_up_us = 20000;
+  udp.parameter.latency_down_us = 20000;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(PRECISE_SNTP_POLL_IDLE, sntp.get_poll_state());
+  assertEqual(1, sntp.service());
+  assertTrue(sntp.begin_poll(true));
+  assertFalse(sntp.begin_poll(true));
+  // the running poll is neither restarted nor finished
+  assertEqual(13, sntp.force_update());
+  assertEqual(PRECISE_SNTP_POLL_SEND, sntp.get_poll_state());
+  uint8_t ret;
+  uint16_t calls = 0;
+  unsigned long longest_call = 0;
+  do {
+    const unsigned long start = micros();
+    ret = sntp.service();
+    if (micros() - start > longest_call) {
+      longest_call = micros() - start;
+    }
+    calls++;
+  } while (ret == PRECISE_SNTP_POLL_PENDING);
+  assertEqual(0, ret);
+  assertEqual(PRECISE_SNTP_POLL_IDLE, sntp.get_poll_state());
+  // about 40 ms waiting are spread over many calls
+  assertMore(calls, 1000);
+  assertLessOrEqual(longest_call, udp.parameter.poll_step_us);
+  assertTrue(sntp.is_synchronized());
+}
+
+static uint8_t callback_result = 255;
+static uint8_t callback_count = 0;
+
+static void callback(uint8_t result) {
+  callback_result = result;
+  callback_count++;
+}
+
+unittest(test_poll_callback) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  callback_count = 0;
+  sntp.set_poll_callback(callback);
+  assertEqual(0, sntp.force_update(true));
+  assertEqual(1, callback_count);
+  assertEqual(0, callback_result);
+  udp.parameter.loss_percent = 100;
+  assertEqual(6, sntp.force_update());
+  assertEqual(2, callback_count);
+  assertEqual(6, callback_result);
+}
+
+unittest(test_error_codes) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, "pool.ntp.org");
+  udp.fail_begin = true;
+  assertEqual(2, sntp.force_update());
+  udp.fail_begin = false;
+  udp.fail_begin_packet = true;
+  assertEqual(3, sntp.force_update());
+  udp.fail_begin_packet = false;
+  udp.parameter.loss_percent = 100;
+  assertEqual(6, sntp.force_update());
+  udp.parameter.loss_percent = 0;
+  udp.parameter.bogus_origin = true;
+  assertEqual(7, sntp.force_update());
+  udp.parameter.bogus_origin = false;
+  udp.parameter.stratum = 0;
+  assertEqual(8, sntp.force_update());
+  assertFalse(sntp.is_synchronized());
+  udp.parameter.stratum = 1;
+  assertEqual(0, sntp.force_update());
+  assertTrue(sntp.is_synchronized());
+}
+
+unittest(test_first_update_sets_clock) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(0, sntp.update());
+  // the transmit timestamp is used, so the error is about the latency
+  const int64_t error = udp.clock_error(sntp.get_local_clock());
+  assertLess(abs(error), (int64_t) (2 * UNITS_PER_MS));
+  assertEqual(1, sntp.update()); // poll policy
+  assertEqual(1, udp.packets_sent);
+}
+
+unittest(test_clock_filter_uses_lowest_delay) {
+  ntp_server_simulator udp(3900000000UL, 42);
+  // asymmetric jitter: only the replies are randomly delayed
+  udp.parameter.latency_up_us = 1000;
+  udp.parameter.latency_down_us = 1000;
+  udp.parameter.jitter_us = 20000;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(0, sntp.force_update_iburst(9, 100) & 0xF);
+  const int64_t error = udp.clock_error(sntp.get_local_clock());
+  // a single sample could be off by up to 10 ms
+  assertLess(abs(error), (int64_t) (5 * UNITS_PER_MS));
+  assertLess(sntp.get_delay(), (uint64_t) (25 * UNITS_PER_MS));
+  assertMore(sntp.get_jitter(), (uint64_t) 0);
+}
+
+/*
+  a simulated server, which cannot be reached from the given request on
+*/
+class late_failing_server : public ntp_server_simulator {
+ public:
+  using ntp_server_simulator::beginPacket;
+  uint8_t fail_from = 255;
+  uint8_t requests = 0;
+  int beginPacket(IPAddress ip, uint16_t port) {
+    requests++;
+    const int ret = ntp_server_simulator::beginPacket(ip, port);
+    return (requests >= fail_from) ? 0 : ret;
+  }
+};
+
+unittest(test_iburst_result_of_late_pulls) {
+  late_failing_server udp;
+  udp.fail_from = 9;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  const uint64_t ret = sntp.force_update_iburst(10, 100);
+  // 8 good pulls, the 9th and 10th cannot start the connection (3)
+  assertEqual(0, ret & 0xFFFFFFFFULL);
+  assertEqual(3, (ret >> 32) & 0xF);
+  assertEqual(3, (ret >> 36) & 0xF);
+  assertEqual(0, ret >> 40);
+}
+
+unittest(test_send_time_is_not_delay) {
+  ntp_server_simulator udp;
+  // a slow name resolution in beginPacket() is not part of the delay
+  udp.parameter.begin_packet_us = 300000;
+  precise_sntp sntp(udp, "ntp.example.org");
+  assertEqual(0, sntp.force_update(true));
+  udp.advance(1000000);
+  assertEqual(0, sntp.force_update());
+  assertLess(sntp.get_delay(), (uint64_t) (3 * UNITS_PER_MS));
+  const int64_t error = udp.clock_error(sntp.get_local_clock());
+  assertLess(abs(error), (int64_t) (2 * UNITS_PER_MS));
+}
+
+static ntp_server_simulator *hook_udp = NULL;
+
+static bool receive_timestamp_hook(unsigned long *ticks) {
+#ifdef PRECISE_SNTP_USE_MICROS
+  *ticks = hook_udp->last_arrival_us;
+#else
+  *ticks = hook_udp->last_arrival_us / 1000;
+#endif
+  return true;
+}
+
+unittest(test_receive_timestamp_hook) {
+  ntp_server_simulator udp;
+  hook_udp = &udp;
+  // the answer is only seen 20 ms after its arrival
+  udp.parameter.poll_step_us = 20000;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(0, sntp.force_update(true));
+  udp.advance(1000000);
+  assertEqual(0, sntp.force_update());
+  assertMore(sntp.get_delay(), (uint64_t) (15 * UNITS_PER_MS));
+  sntp.set_receive_timestamp_hook(receive_timestamp_hook);
+  for (uint8_t i = 0; i < 4; i++) {
+    udp.advance(1000000);
+    assertEqual(0, sntp.force_update());
+  }
+  assertLess(sntp.get_delay(), (uint64_t) (3 * UNITS_PER_MS));
+  const int64_t error = udp.clock_error(sntp.get_local_clock());
+  assertLess(abs(error), (int64_t) (2 * UNITS_PER_MS));
+}
+
+unittest(test_frequency_discipline) {
+  ntp_server_simulator udp;
+  udp.parameter.drift_ppm = 50.0;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_poll_exponent_range(6, 10);
+  for (uint32_t i = 0; i < 6 * 3600; i++) {
+    sntp.update_adapt_poll_period();
+    udp.advance(1000000);
+  }
+  // local oscillator is 50 ppm too fast: about -50 ppm (4295 is about 1 ppm)
+  assertLess(sntp.get_frequency(), -45 * 4295);
+  assertMore(sntp.get_frequency(), -55 * 4295);
+  const int64_t error = udp.clock_error(sntp.get_local_clock());
+  assertLess(abs(error), (int64_t) (5 * UNITS_PER_MS));
+}
+
+unittest_main()
@@ -0,0 +1,139 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Tests of slewing the corrections (set_slew_rate()) and of
+  get_monotonic_clock() using the simulated ntp server in
+  extras/ntp_server_simulator.h.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp.h>
+#include "../extras/ntp_server_simulator.h"
+
+#define UNITS_PER_MS 4294967.296
+
+unittest_setup() {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+}
+
+static uint64_t as_uint64(struct ntp_timestamp_format_struct t) {
+  return (((uint64_t) t.seconds) << 32) + t.fraction;
+}
+
+/*
+  error of the local clock compared to the clock of the server in ms
+*/
+static double error_ms(ntp_server_simulator &udp, precise_sntp &sntp) {
+  return ((double) udp.clock_error(sntp.get_local_clock())) / UNITS_PER_MS -
+    udp.parameter.offset_us / 1000.0;
+}
+
+/*
+  runs update_async(true) every 10 ms (while waiting for the server every
+  0.1 ms) for seconds, returns the
+  largest step back of get_local_clock() (in ms) and sets monotonic to
+  false, if get_monotonic_clock() went backwards
+*/
+static double run(ntp_server_simulator &udp, precise_sntp &sntp,
+		  unsigned long seconds, bool *monotonic) {
+  double step_back = 0.0;
+  uint64_t last = as_uint64(sntp.get_local_clock());
+  uint64_t last_monotonic = as_uint64(sntp.get_monotonic_clock());
+  const unsigned long end = micros() + seconds * 1000000UL;
+  while ((long) (end - micros()) > 0) {
+    udp.advance((sntp.get_poll_state() == PRECISE_SNTP_POLL_IDLE) ?
+		10000 : 100);
+    sntp.update_async(true);
+    const uint64_t now = as_uint64(sntp.get_local_clock());
+    const uint64_t now_monotonic = as_uint64(sntp.get_monotonic_clock());
+    if ((int64_t) (last - now) / UNITS_PER_MS > step_back) {
+      step_back = (int64_t) (last - now) / UNITS_PER_MS;
+    }
+    if (now_monotonic < last_monotonic) {
+      *monotonic = false;
+    }
+    last = now;
+    last_monotonic = now_monotonic;
+  }
+  return step_back;
+}
+
+unittest(test_step_goes_back) {
+  ntp_server_simulator udp;
+  udp.parameter.drift_ppm = 200.0; // local clock too fast
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_poll_exponent_range(4, 4);
+  bool monotonic = true;
+  const double step_back = run(udp, sntp, 600, &monotonic);
+  // each correction steps the clock back by about 16 s * 200 ppm
+  assertMore(step_back, 1.0);
+  assertTrue(monotonic);
+}
+
+unittest(test_slew_never_goes_back) {
+  ntp_server_simulator udp;
+  udp.parameter.drift_ppm = 200.0;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_poll_exponent_range(4, 4);
+  sntp.set_slew_rate(500);
+  bool monotonic = true;
+  // the first answer sets the clock
+  assertEqual(0, sntp.update());
+  const double step_back = run(udp, sntp, 1200, &monotonic);
+  assertEqual(0.0, step_back);
+  assertTrue(monotonic);
+  // the frequency error is learned as with stepping
+  assertLess(sntp.get_frequency(), -4295 * 180);
+  assertMore(sntp.get_frequency(), -4295 * 220);
+  assertLess(fabs(error_ms(udp, sntp)), 1.0);
+}
+
+unittest(test_slew_rate) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_slew_rate(500);
+  assertEqual(0, sntp.update());
+  assertEqual(0, sntp.force_update());
+  assertLess(fabs(error_ms(udp, sntp)), 1.0);
+  // the server is 20 ms ahead: 40 seconds to slew it with 500 ppm
+  udp.parameter.offset_us = 20000;
+  assertEqual(0, sntp.force_update());
+  assertMore(fabs(error_ms(udp, sntp)), 19.0);
+  udp.advance(20000000);
+  assertMore(fabs(error_ms(udp, sntp)), 9.0);
+  assertLess(fabs(error_ms(udp, sntp)), 11.0);
+  // a further poll while slewing does not count the pending part twice
+  assertEqual(0, sntp.force_update());
+  udp.advance(30000000);
+  assertLess(fabs(error_ms(udp, sntp)), 1.0);
+  // without slewing the pending correction is applied at once
+  udp.parameter.offset_us = 30000;
+  assertEqual(0, sntp.force_update());
+  sntp.set_slew_rate(0);
+  assertLess(fabs(error_ms(udp, sntp)), 1.0);
+}
+
+unittest(test_large_error_steps) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.set_slew_rate(500);
+  assertEqual(0, sntp.update());
+  assertEqual(0, sntp.force_update());
+  // the server is 2 s behind: the clock is stepped back
+  udp.parameter.offset_us = -2000000;
+  const uint64_t before = as_uint64(sntp.get_monotonic_clock());
+  assertEqual(0, sntp.force_update());
+  assertLess(fabs(error_ms(udp, sntp)), 1.0);
+  // the monotonic clock waits until the local clock reaches it again
+  assertTrue(as_uint64(sntp.get_monotonic_clock()) >= before);
+  assertTrue(as_uint64(sntp.get_local_clock()) < before);
+  udp.advance(2100000);
+  assertTrue(as_uint64(sntp.get_monotonic_clock()) ==
+	     as_uint64(sntp.get_local_clock()));
+}
+
+unittest_main()
@@ -0,0 +1,256 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Tests of the warm start: export_state(), import_state(), save_state()
+  and load_state() using the simulated ntp server in
+  extras/ntp_server_simulator.h and the file storage in
+  extras/posix/posix_file_storage.h.
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <precise_sntp.h>
+#include <precise_sntp_crc16.h>
+#include <precise_sntp_storage.h>
+#include "../extras/ntp_server_simulator.h"
+#include "../extras/posix/posix_file_storage.h"
+
+static uint16_t resolver_calls = 0;
+
+// a pool name rotating over 3 addresses
+static int resolver(const char* name, IPAddress &ip) {
+  (void) name;
+  ip = IPAddress(192, 168, 178, 1 + (resolver_calls % 3));
+  resolver_calls++;
+  return 1;
+}
+
+// storage in RAM, e. g. instead of an EEPROM
+class ram_storage : public precise_sntp_storage {
+ public:
+  uint8_t data[PRECISE_SNTP_STATE_SIZE] = {};
+  bool written = false;
+  bool read(uint8_t *buffer, size_t size) {
+    if ((!written) || (size > sizeof(data))) {
+      return false;
+    }
+    memcpy(buffer, data, size);
+    return true;
+  }
+  bool write(const uint8_t *buffer, size_t size) {
+    if (size > sizeof(data)) {
+      return false;
+    }
+    memcpy(data, buffer, size);
+    written = true;
+    return true;
+  }
+};
+
+unittest_setup() {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+  resolver_calls = 0;
+}
+
+/*
+  runs update_adapt_poll_period() for the given time in seconds
+*/
+static void run(ntp_server_simulator &udp, precise_sntp &sntp,
+		uint32_t seconds) {
+  for (uint32_t i = 0; i < seconds; i++) {
+    sntp.update_adapt_poll_period();
+    udp.advance(1000000);
+  }
+}
+
+unittest(test_round_trip) {
+  ntp_server_simulator udp;
+  udp.parameter.drift_ppm = 50.0;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(0, sntp.update());
+  udp.advance(60000000);
+  assertEqual(0, sntp.force_update());
+  uint8_t buffer[PRECISE_SNTP_STATE_SIZE];
+  assertEqual(PRECISE_SNTP_STATE_SIZE,
+	      sntp.export_state(buffer, PRECISE_SNTP_STATE_SIZE));
+  assertEqual('P', buffer[0]);
+  assertEqual('S', buffer[1]);
+  assertEqual(PRECISE_SNTP_STATE_VERSION, buffer[2]);
+  assertEqual(1, buffer[15]);
+  precise_sntp restored(udp, IPAddress(192, 168, 178, 1));
+  assertTrue(restored.import_state(buffer, PRECISE_SNTP_STATE_SIZE));
+  assertEqual(sntp.get_frequency(), restored.get_frequency());
+  uint8_t again[PRECISE_SNTP_STATE_SIZE];
+  assertEqual(PRECISE_SNTP_STATE_SIZE,
+	      restored.export_state(again, PRECISE_SNTP_STATE_SIZE));
+  // the clock of the restored one is not synchronized yet
+  again[15] = buffer[15];
+  const uint16_t crc = precise_sntp_crc16(again, PRECISE_SNTP_STATE_SIZE - 2);
+  again[PRECISE_SNTP_STATE_SIZE - 2] = (uint8_t) crc;
+  again[PRECISE_SNTP_STATE_SIZE - 1] = (uint8_t) (crc >> 8);
+  assertEqual(0, memcmp(buffer, again, PRECISE_SNTP_STATE_SIZE));
+}
+
+unittest(test_invalid) {
+  ntp_server_simulator udp;
+  udp.parameter.drift_ppm = 50.0;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(0, sntp.update());
+  udp.advance(60000000);
+  assertEqual(0, sntp.force_update());
+  uint8_t buffer[PRECISE_SNTP_STATE_SIZE];
+  assertEqual(0, sntp.export_state(buffer, PRECISE_SNTP_STATE_SIZE - 1));
+  assertEqual(PRECISE_SNTP_STATE_SIZE,
+	      sntp.export_state(buffer, PRECISE_SNTP_STATE_SIZE));
+  precise_sntp restored(udp, IPAddress(192, 168, 178, 1));
+  // too short
+  assertFalse(restored.import_state(buffer, PRECISE_SNTP_STATE_SIZE - 1));
+  // wrong CRC
+  buffer[5] ^= 1;
+  assertFalse(restored.import_state(buffer, PRECISE_SNTP_STATE_SIZE));
+  buffer[5] ^= 1;
+  // other version
+  buffer[2]++;
+  assertFalse(restored.import_state(buffer, PRECISE_SNTP_STATE_SIZE));
+  buffer[2]--;
+  assertEqual(0, restored.get_frequency());
+  assertTrue(restored.import_state(buffer, PRECISE_SNTP_STATE_SIZE));
+  assertEqual(sntp.get_frequency(), restored.get_frequency());
+}
+
+unittest(test_storage) {
+  ntp_server_simulator udp;
+  udp.parameter.drift_ppm = -20.0;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  ram_storage storage;
+  assertFalse(sntp.load_state(storage));
+  assertEqual(0, sntp.update());
+  udp.advance(60000000);
+  assertEqual(0, sntp.force_update());
+  assertTrue(sntp.save_state(storage));
+  precise_sntp restored(udp, IPAddress(192, 168, 178, 1));
+  assertTrue(restored.load_state(storage));
+  assertEqual(sntp.get_frequency(), restored.get_frequency());
+}
+
+unittest(test_file_storage) {
+  ntp_server_simulator udp;
+  udp.parameter.drift_ppm = 30.0;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/precise_sntp_state_%d",
+	   (int) getpid());
+  remove(path);
+  posix_file_storage storage(path);
+  assertFalse(sntp.load_state(storage));
+  assertEqual(0, sntp.update());
+  udp.advance(60000000);
+  assertEqual(0, sntp.force_update());
+  assertTrue(sntp.save_state(storage));
+  precise_sntp restored(udp, IPAddress(192, 168, 178, 1));
+  assertTrue(restored.load_state(storage));
+  assertEqual(sntp.get_frequency(), restored.get_frequency());
+  remove(path);
+}
+
+unittest(test_warm_start) {
+  ntp_server_simulator udp;
+  udp.parameter.drift_ppm = 50.0;
+  uint8_t buffer[PRECISE_SNTP_STATE_SIZE];
+  {
+    precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+    sntp.set_poll_exponent_range(6, 10);
+    run(udp, sntp, 6 * 3600);
+    sntp.export_state(buffer, PRECISE_SNTP_STATE_SIZE);
+  }
+  const uint8_t poll_exponent = buffer[12];
+  assertMore(poll_exponent, 6);
+  // reboot: the first poll continues with the learned state
+  precise_sntp warm(udp, IPAddress(192, 168, 178, 1));
+  warm.set_poll_exponent_range(6, 10);
+  assertTrue(warm.import_state(buffer, PRECISE_SNTP_STATE_SIZE));
+  assertEqual(0, warm.update_adapt_poll_period());
+  uint8_t state[PRECISE_SNTP_STATE_SIZE];
+  warm.export_state(state, PRECISE_SNTP_STATE_SIZE);
+  assertEqual(poll_exponent, state[12]);
+  // a cold start begins with the minimal poll exponent
+  precise_sntp cold(udp, IPAddress(192, 168, 178, 1));
+  cold.set_poll_exponent_range(6, 10);
+  assertEqual(0, cold.update_adapt_poll_period());
+  cold.export_state(state, PRECISE_SNTP_STATE_SIZE);
+  assertEqual(6, state[12]);
+  // without learning the frequency again the clock stays close
+  udp.advance(1000000);
+  warm.update_adapt_poll_period();
+  cold.update_adapt_poll_period();
+  udp.advance(600000000);
+  const double warm_error =
+    ((double) udp.clock_error(warm.get_local_clock())) / 4294967.296;
+  const double cold_error =
+    ((double) udp.clock_error(cold.get_local_clock())) / 4294967.296;
+  assertLess(fabs(warm_error), 2.0);
+  assertMore(fabs(cold_error), 20.0);
+}
+
+unittest(test_resolved_system_peer) {
+  ntp_server_simulator udp;
+  udp.server(IPAddress(192, 168, 178, 1));
+  udp.server(IPAddress(192, 168, 178, 2));
+  udp.server(IPAddress(192, 168, 178, 3));
+  uint8_t buffer[PRECISE_SNTP_STATE_SIZE];
+  {
+    precise_sntp sntp(udp, "pool.example.org");
+    sntp.set_resolver(resolver);
+    assertEqual(0, sntp.force_update());
+    sntp.export_state(buffer, PRECISE_SNTP_STATE_SIZE);
+  }
+  assertEqual(1, resolver_calls);
+  assertEqual(1, udp.server(IPAddress(192, 168, 178, 1)).requests);
+  // the next resolution would give another address
+  precise_sntp sntp(udp, "pool.example.org");
+  sntp.set_resolver(resolver);
+  assertTrue(sntp.import_state(buffer, PRECISE_SNTP_STATE_SIZE));
+  assertEqual(0, sntp.force_update());
+  assertEqual(1, resolver_calls);
+  assertEqual(2, udp.server(IPAddress(192, 168, 178, 1)).requests);
+  assertEqual(0, udp.server(IPAddress(192, 168, 178, 2)).requests);
+}
+
+unittest(test_import_keeps_past) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  assertEqual(0, sntp.update());
+  udp.advance(100000000);
+  const unsigned long event = PRECISE_SNTP_TICKS();
+  const struct ntp_timestamp_format_struct event_clock =
+    sntp.get_local_clock();
+  // import a state with a frequency of 400 ppm
+  uint8_t buffer[PRECISE_SNTP_STATE_SIZE];
+  sntp.export_state(buffer, PRECISE_SNTP_STATE_SIZE);
+  const uint32_t frequency = 400UL * 4295UL;
+  for (uint8_t i = 0; i < 4; i++) {
+    buffer[4 + i] = (uint8_t) (frequency >> (8 * i));
+  }
+  const uint16_t crc = precise_sntp_crc16(buffer, PRECISE_SNTP_STATE_SIZE - 2);
+  buffer[PRECISE_SNTP_STATE_SIZE - 2] = (uint8_t) crc;
+  buffer[PRECISE_SNTP_STATE_SIZE - 1] = (uint8_t) (crc >> 8);
+  assertTrue(sntp.import_state(buffer, PRECISE_SNTP_STATE_SIZE));
+  assertEqual((int32_t) frequency, sntp.get_frequency());
+  udp.advance(100000000);
+  // the ticks before the import are converted with the old frequency
+  struct ntp_timestamp_format_struct past;
+  sntp.convert_past_ticks(&event, &past, 1);
+  const int64_t error = (int64_t)
+    (((((uint64_t) past.seconds) << 32) + past.fraction) -
+     ((((uint64_t) event_clock.seconds) << 32) + event_clock.fraction));
+  assertLess(fabs((double) error) / 4294967.296, 0.01); // ms
+}
+
+unittest_main()
@@ -0,0 +1,172 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+
+  Tests of the statistics (get_statistics()).
+
+  The statistics are only available if PRECISE_SNTP_STATISTICS is defined
+  (e. g. in precise_sntp.h), otherwise no test is done here. arduino_ci
+  runs these tests on the platform zero_statistics, which defines
+  PRECISE_SNTP_STATISTICS (see .arduino-ci.yaml).
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <string.h>
+
+#include <precise_sntp.h>
+#include "../extras/ntp_server_simulator.h"
+
+#define UNITS_PER_MS 4294967.296
+
+unittest_setup() {
+  GODMODE()->reset();
+  GODMODE()->micros = 1000000;
+}
+
+#ifdef PRECISE_SNTP_STATISTICS
+unittest(test_counters) {
+  ntp_server_simulator udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  struct precise_sntp_statistics stat = sntp.get_statistics();
+  assertEqual(0, stat.requests);
+  assertEqual(0, stat.samples);
+  assertEqual(0, stat.number_of_samples);
+  assertEqual(0, sntp.update()); // sets the clock, no sample
+  assertEqual(1, sntp.update()); // too early
+  stat = sntp.get_statistics();
+  assertEqual(1, stat.results[0]);
+  assertEqual(1, stat.results[1]);
+  assertEqual(1, stat.requests);
+  assertEqual(0, stat.samples);
+  udp.parameter.silent = true;
+  assertEqual(6, sntp.force_update());
+  stat = sntp.get_statistics();
+  assertEqual(1, stat.results[6]);
+  assertEqual(2, stat.requests);
+  // the timeout is part of the poll
+  assertMoreOrEqual(stat.poll_duration, 990000UL);
+  assertEqual(stat.poll_duration, stat.poll_duration_max);
+  assertLessOrEqual(stat.service_time, stat.poll_duration);
+  sntp.reset_statistics();
+  stat = sntp.get_statistics();
+  assertEqual(0, stat.results[6]);
+  assertEqual(0, stat.requests);
+  assertEqual(0, stat.poll_duration_max);
+}
+
+unittest(test_samples) {
+  ntp_server_simulator udp;
+  udp.parameter.latency_up_us = 2000;
+  udp.parameter.latency_down_us = 2000;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  sntp.add_server(IPAddress(192, 168, 178, 2));
+  assertEqual(0, sntp.force_update()); // sets the clock
+  sntp.reset_statistics();
+  for (uint8_t i = 0; i < 10; i++) {
+    udp.advance(1000000);
+    assertEqual(0, sntp.force_update());
+  }
+  struct precise_sntp_statistics stat = sntp.get_statistics();
+  assertEqual(20, stat.requests);
+  assertEqual(20, stat.samples);
+  assertEqual(PRECISE_SNTP_STATISTICS_SAMPLES, stat.number_of_samples);
+  // the newest sample is from the last server
+  assertEqual(1, stat.last_samples[0].server);
+  assertEqual(0, stat.last_samples[1].server);
+  assertMoreOrEqual(stat.last_samples[0].time, stat.last_samples[1].time);
+  const double mean = ((double) stat.offset_mean) / UNITS_PER_MS;
+  assertLess(fabs(mean), 0.5);
+  assertLessOrEqual(stat.offset_min, stat.offset_mean);
+  assertMoreOrEqual(stat.offset_max, stat.offset_mean);
+  // the round-trip delay is about 4 ms
+  const double delay = ((double) stat.delay_mean) / UNITS_PER_MS;
+  assertLess(fabs(delay - 4.0), 0.5);
+  assertLessOrEqual(stat.delay_min, stat.delay_mean);
+  assertMoreOrEqual(stat.delay_max, stat.delay_mean);
+  // 4 ms is in bucket 13 (2^-8 s ... 2^-7 s)
+  uint32_t delays = 0;
+  uint32_t offsets = 0;
+  for (uint8_t i = 0; i < PRECISE_SNTP_STATISTICS_BUCKETS; i++) {
+    delays += stat.delay_histogram[i];
+    offsets += stat.offset_histogram[i];
+  }
+  assertEqual(20, delays);
+  assertEqual(20, offsets);
+  assertEqual(20, stat.delay_histogram[13]);
+  assertEqual(0, stat.offset_histogram[PRECISE_SNTP_STATISTICS_BUCKETS - 1]);
+}
+
+/*
+  a falseticker jumping by about 34 years (2^62 units) each answer
+*/
+class jumping_server : public UDP {
+ public:
+  uint32_t seconds = 0x10000000;
+  uint8_t begin(uint16_t) {
+    return 1;
+  }
+  int beginPacket(IPAddress, uint16_t) {
+    return 1;
+  }
+  int beginPacket(const char*, uint16_t) {
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t size) {
+    memcpy(_xmt, buffer + 40, 8);
+    return size;
+  }
+  int endPacket() {
+    _answer = true;
+    return 1;
+  }
+  int parsePacket() {
+    return _answer ? 48 : 0;
+  }
+  int read(unsigned char* buffer, size_t len) {
+    memset(buffer, 0, len);
+    buffer[0] = (4 << 3) | 4;
+    buffer[1] = 1;
+    memcpy(buffer + 24, _xmt, 8);
+    for (uint8_t i = 0; i < 4; i++) {
+      buffer[32 + i] = buffer[40 + i] = (uint8_t) (seconds >> (24 - 8 * i));
+    }
+    seconds += 0x40000000;
+    _answer = false;
+    return (int) len;
+  }
+  int read(char* buffer, size_t len) {
+    return read((unsigned char*) buffer, len);
+  }
+  IPAddress remoteIP() {
+    return IPAddress(192, 168, 178, 1);
+  }
+  uint16_t remotePort() {
+    return 123;
+  }
+
+ private:
+  uint8_t _xmt[8] = {};
+  bool _answer = false;
+};
+
+unittest(test_falseticker_does_not_overflow) {
+  jumping_server udp;
+  precise_sntp sntp(udp, IPAddress(192, 168, 178, 1));
+  for (uint8_t i = 0; i < 8; i++) {
+    sntp.force_update();
+    delay(1000);
+  }
+  const struct precise_sntp_statistics stat = sntp.get_statistics();
+  assertMore(stat.samples, 2);
+  assertLessOrEqual(stat.offset_mean, PRECISE_SNTP_STATISTICS_MEAN_LIMIT);
+  assertMoreOrEqual(stat.offset_mean, -PRECISE_SNTP_STATISTICS_MEAN_LIMIT);
+  assertLessOrEqual(stat.delay_mean,
+		    (uint64_t) PRECISE_SNTP_STATISTICS_MEAN_LIMIT);
+  assertEqual(stat.samples,
+	      stat.offset_histogram[PRECISE_SNTP_STATISTICS_BUCKETS - 1]);
+}
+#endif
+
+unittest_main()
@@ -0,0 +1,66 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp_ticks2duration.h>
+
+// reference: full seconds and remainder converted separately by division
+static uint64_t reference(uint64_t ticks, uint32_t tps) {
+  return ((ticks / tps) << 32) + (((ticks % tps) << 32) + tps / 2) / tps;
+}
+
+static uint64_t difference(uint64_t a, uint64_t b) {
+  return (a > b) ? (a - b) : (b - a);
+}
+
+unittest(test_ticks2duration_constants) {
+  assertEqual(4294967UL, PRECISE_SNTP_DURATION_PER_TICK_INT(1000));
+  assertEqual(1271310320UL, PRECISE_SNTP_DURATION_PER_TICK_FRAC(1000));
+  assertEqual(4294UL, PRECISE_SNTP_DURATION_PER_TICK_INT(1000000));
+  assertEqual(4154504686UL, PRECISE_SNTP_DURATION_PER_TICK_FRAC(1000000));
+}
+
+unittest(test_ticks2duration_millis) {
+  const uint32_t i = PRECISE_SNTP_DURATION_PER_TICK_INT(1000);
+  const uint32_t f = PRECISE_SNTP_DURATION_PER_TICK_FRAC(1000);
+  uint64_t result = 0;
+  assertEqual(result, precise_sntp_ticks2duration(0, i, f));
+  result = 4294967; // 2^32 / 1000 rounded
+  assertEqual(result, precise_sntp_ticks2duration(1, i, f));
+  result = 4294967296ULL;
+  assertEqual(result, precise_sntp_ticks2duration(1000, i, f));
+  result = 2147483648ULL + 4294967296ULL * 86400ULL;
+  assertEqual(result, precise_sntp_ticks2duration(86400500ULL, i, f));
+  for (uint64_t ticks = 1; ticks < 0xFFFFFFFFULL; ticks = ticks * 3 + 7) {
+    assertLessOrEqual(difference(reference(ticks, 1000),
+				 precise_sntp_ticks2duration(ticks, i, f)),
+		      1);
+  }
+  // overflow of millis() counted in the upper 32 bit
+  assertLessOrEqual(difference(reference(4294967296ULL, 1000),
+			       precise_sntp_ticks2duration(4294967296ULL,
+							   i, f)),
+		    1);
+}
+
+unittest(test_ticks2duration_micros) {
+  const uint32_t i = PRECISE_SNTP_DURATION_PER_TICK_INT(1000000);
+  const uint32_t f = PRECISE_SNTP_DURATION_PER_TICK_FRAC(1000000);
+  uint64_t result = 4295; // 2^32 / 10^6 rounded
+  assertEqual(result, precise_sntp_ticks2duration(1, i, f));
+  result = 4294967296ULL;
+  assertEqual(result, precise_sntp_ticks2duration(1000000, i, f));
+  result = 2147483648ULL + 4294967296ULL * 4294ULL;
+  assertEqual(result, precise_sntp_ticks2duration(4294500000ULL, i, f));
+  for (uint64_t ticks = 1; ticks < 0xFFFFFFFFULL; ticks = ticks * 3 + 7) {
+    assertLessOrEqual(difference(reference(ticks, 1000000),
+				 precise_sntp_ticks2duration(ticks, i, f)),
+		      1);
+  }
+}
+
+unittest_main()
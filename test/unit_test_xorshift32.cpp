@@ -0,0 +1,26 @@
+/*
+  Author: Daniel Mohr
+  Date: 2026-10-17
+*/
+
+#include <Arduino.h>
+#include <ArduinoUnitTests.h>
+
+#include <precise_sntp_xorshift32.h>
+
+unittest(test_xorshift32_sequence) {
+  uint32_t state = 1;
+  assertEqual(270369UL, precise_sntp_xorshift32(&state));
+  assertEqual(270369UL, state);
+  assertEqual(67634689UL, precise_sntp_xorshift32(&state));
+  assertEqual(2647435461UL, precise_sntp_xorshift32(&state));
+}
+
+unittest(test_xorshift32_never_zero) {
+  uint32_t state = 0xDEADBEEFUL;
+  for (uint16_t i = 0; i < 10000; i++) {
+    assertNotEqual(0UL, precise_sntp_xorshift32(&state));
+  }
+}
+
+unittest_main()